@@ -4,21 +4,24 @@
 
 #include <raylib.h>
 #include <raymath.h>
+#include <math.h>
 #include <box2d/box2d.h>
 #include <box2d/math_functions.h>
 
+#include "arena.h"
 #include "entities.h"
 #include "interface.h"
+#include "levels.h"
+#include "sprites.h"
 
 extern Texture TextureLibrary[TextureEnumSize];
 extern Sound SoundLibrary[SoundEnumSize];
 
-void DrawWalls(Camera2D* camera) {
-    int width = 1920, height = 1080;
+void DrawWalls(Camera2D* camera, Vector2 screenSize) {
     Vector2 screenOrigin = GetScreenToWorld2D((Vector2){0, 0}, *camera);
-    Vector2 screenMax = GetScreenToWorld2D((Vector2){width, height}, *camera);
+    Vector2 screenMax = GetScreenToWorld2D(screenSize, *camera);
     int blockSize = TextureLibrary[t_wall_left].width;
-    int wallHeight = (screenMax.y - screenOrigin.y / blockSize);
+    int wallHeight = (int)ceilf((screenMax.y - screenOrigin.y) / blockSize);
     float xPosL = screenOrigin.x;
     float xPosR = screenMax.x - blockSize;
     for (int i = 1; i < wallHeight; i++) {
@@ -27,28 +30,28 @@ void DrawWalls(Camera2D* camera) {
         Vector2 posR = {xPosR, yPos};
         if (i == 1)
         {
-            DrawTextureEx(
-                TextureLibrary[t_wall_left_top], 
+            DrawSprite(
+                t_wall_left_top, 
                 posL, 
                 0, 
                 1.0f, 
                 WHITE);
-            DrawTextureEx(
-                TextureLibrary[t_wall_right_top], 
+            DrawSprite(
+                t_wall_right_top, 
                 posR, 
                 0, 
                 1.0f, 
                 WHITE);
         }
         else {
-            DrawTextureEx(
-                TextureLibrary[t_wall_left], 
+            DrawSprite(
+                t_wall_left, 
                 posL, 
                 0, 
                 1.0f, 
                 WHITE);
-            DrawTextureEx(
-                TextureLibrary[t_wall_right], 
+            DrawSprite(
+                t_wall_right, 
                 posR, 
                 0, 
                 1.0f, 
@@ -57,49 +60,47 @@ void DrawWalls(Camera2D* camera) {
     }
 }
 
-void DrawCeiling(Camera2D* camera) {
-    int width = 1920, height = 1080;
+void DrawCeiling(Camera2D* camera, Vector2 screenSize) {
     Vector2 screenOrigin = GetScreenToWorld2D((Vector2){0, 0}, *camera);
-    Vector2 screenMax = GetScreenToWorld2D((Vector2){width, height}, *camera);
+    Vector2 screenMax = GetScreenToWorld2D(screenSize, *camera);
     int blockSize = TextureLibrary[t_ceiling_left].width;
-    int ceilWidth = (screenMax.x - screenOrigin.x / blockSize);
+    int ceilWidth = (int)ceilf((screenMax.x - screenOrigin.x) / blockSize);
     float yPos = screenOrigin.y;
     for (int i = 0; i < ceilWidth; i++) {
         float xPos = screenOrigin.x + i * blockSize;
-        DrawTextureEx(TextureLibrary[t_ceiling_mid], (Vector2){xPos, yPos}, 0, 1.0f, WHITE);
+        DrawSprite(t_ceiling_mid, (Vector2){xPos, yPos}, 0, 1.0f, WHITE);
     }
 }
 
-void DrawBackground(Camera2D* camera) {
-    int width = 1920, height = 1080;
+void DrawBackground(Camera2D* camera, Vector2 screenSize) {
     Vector2 screenOrigin = GetScreenToWorld2D((Vector2){0, 0}, *camera);
-    Vector2 screenMax = GetScreenToWorld2D((Vector2){width, height}, *camera);
-    Vector2 screenCenter = GetScreenToWorld2D((Vector2){width/2.0f, height/2.0f}, *camera);
+    Vector2 screenMax = GetScreenToWorld2D(screenSize, *camera);
+    Vector2 screenCenter = GetScreenToWorld2D((Vector2){screenSize.x / 2.0f, screenSize.y / 2.0f}, *camera);
 
     int scaleFactor = 2;
     int blockSize = TextureLibrary[t_bg_ground].width * scaleFactor;
-    int backgroundWidth = (screenMax.x - screenCenter.x / blockSize);
+    int backgroundWidth = (int)ceilf((screenMax.x - screenOrigin.x) / blockSize);
     Color tint = {125, 150, 175, 255};
 
     for (int j = 0; j < backgroundWidth; j++) {
-        DrawTextureEx(
-            TextureLibrary[t_bg_ground], 
+        DrawSprite(
+            t_bg_ground, 
             (Vector2){
                 screenOrigin.x + blockSize * j, 
                 screenCenter.y + 0.5 * blockSize
             }, 
             0, 
             scaleFactor, tint);
-        DrawTextureEx(
-            TextureLibrary[t_bg_view], 
+        DrawSprite(
+            t_bg_view, 
             (Vector2){
                 screenOrigin.x + blockSize * j, 
                 screenCenter.y - 0.5 * blockSize
             }, 
             0, 
             scaleFactor, tint);
-        DrawTextureEx(
-            TextureLibrary[t_bg_sky], 
+        DrawSprite(
+            t_bg_sky, 
             (Vector2){
                 screenOrigin.x + blockSize * j, 
                 screenCenter.y - 1.5 * blockSize
@@ -116,14 +117,89 @@ void DrawLimit(Entity* limit) {
     float yPos = limitPos.y - TextureLibrary[t_limit].height / 2.0f;
     float x0 = limitPos.x - limit->extent.x + texWidth;
     float x1 = limitPos.x + limit->extent.x - texWidth * 2.0f;
-    DrawTextureEx(TextureLibrary[t_limit_end], (Vector2){x0 + texWidth, yPos + texWidth}, 180, 1.0f, WHITE);
-    DrawTextureEx(TextureLibrary[t_limit_end], (Vector2){x1, yPos}, 0, 1.0f, WHITE);
+    DrawSprite(t_limit_end, (Vector2){x0 + texWidth, yPos + texWidth}, 180, 1.0f, WHITE);
+    DrawSprite(t_limit_end, (Vector2){x1, yPos}, 0, 1.0f, WHITE);
     float limitWidth = (limit->extent.x * 2 - texWidth * 2) / texWidth;
     for (int i = 1; i < limitWidth - 1; i++) {
-        DrawTextureEx(TextureLibrary[t_limit], (Vector2){x0 + i * texWidth, yPos}, 0, 1.0f, WHITE);
+        DrawSprite(t_limit, (Vector2){x0 + i * texWidth, yPos}, 0, 1.0f, WHITE);
     }
 }
 
 void DrawDeathZone(Entity* deathZone) {
 
-}
\ No newline at end of file
+}
+
+/*  #########################
+ *      STATIC LAYER
+ *  #########################
+ *
+ * The background, walls, ceiling and level blocks never move, so they are drawn once into a
+ * screen-sized render texture and that texture is drawn each frame. It is redrawn only when
+ * the camera, the screen size or the level changes.
+ */
+
+static bool SameCamera(Camera2D a, Camera2D b) {
+    return a.offset.x == b.offset.x && a.offset.y == b.offset.y
+        && a.target.x == b.target.x && a.target.y == b.target.y
+        && a.rotation == b.rotation && a.zoom == b.zoom;
+}
+
+/**
+ * Force the static layer to be redrawn on its next update, e.g. after a level is loaded.
+ */
+void InvalidateStaticLayer(StaticLayer* layer) {
+    layer->valid = false;
+}
+
+/**
+ * Redraw the static layer if anything it shows has changed: the screen size, the camera or the level.
+ * Call outside BeginDrawing/EndDrawing.
+ * @param layer The layer to update
+ * @param camera The camera the frame is drawn with
+ * @param level The level whose blocks are baked in
+ * @param background The color behind everything, as the layer is opaque
+ */
+void UpdateStaticLayer(StaticLayer* layer, Camera2D* camera, const Level* level, Color background) {
+    int screenWidth = GetScreenWidth();
+    int screenHeight = GetScreenHeight();
+    if (layer->target.texture.width != screenWidth || layer->target.texture.height != screenHeight) {
+        if (IsRenderTextureValid(layer->target))
+            UnloadRenderTexture(layer->target);
+        layer->target = LoadRenderTexture(screenWidth, screenHeight);
+        layer->valid = false;
+    }
+    if (layer->valid && SameCamera(layer->camera, *camera) && layer->levelData == level->data)
+        return;
+
+    Vector2 screenSize = {(float)screenWidth, (float)screenHeight};
+    BeginTextureMode(layer->target);
+    ClearBackground(background);
+    BeginMode2D(*camera);
+    DrawBackground(camera, screenSize);
+    DrawWalls(camera, screenSize);
+    DrawCeiling(camera, screenSize);
+    // Baked in, the blocks draw under everything that moves, boxes included; they used to draw over the boxes
+    DrawLevelBlocks(level);
+    FlushSprites();
+    EndMode2D();
+    EndTextureMode();
+
+    layer->camera = *camera;
+    layer->levelData = level->data;
+    layer->valid = true;
+}
+
+/**
+ * Draw the static layer over the whole screen, in screen space.
+ */
+void DrawStaticLayer(const StaticLayer* layer) {
+    // Render textures are stored upside down
+    Rectangle source = {0, 0, (float)layer->target.texture.width, -(float)layer->target.texture.height};
+    DrawTextureRec(layer->target.texture, source, (Vector2){0, 0}, WHITE);
+}
+
+void UnloadStaticLayer(StaticLayer* layer) {
+    if (IsRenderTextureValid(layer->target))
+        UnloadRenderTexture(layer->target);
+    *layer = (StaticLayer){ 0 };
+}
@@ -5,11 +5,28 @@
 #ifndef ARENA_H
 #define ARENA_H
 #include "entities.h"
+#include "levels.h"
 #include <raylib.h>
 
-void DrawWalls(Camera2D* camera);
-void DrawCeiling(Camera2D* camera);
-void DrawBackground(Camera2D* camera);
+/**
+ * Everything static on screen, baked into one texture. See UpdateStaticLayer.
+ */
+typedef struct StaticLayer {
+    RenderTexture2D target;
+    Camera2D camera;
+    // The level whose blocks are baked in, so switching levels rebakes it
+    const LevelData* levelData;
+    bool valid;
+} StaticLayer;
+
+void DrawWalls(Camera2D* camera, Vector2 screenSize);
+void DrawCeiling(Camera2D* camera, Vector2 screenSize);
+void DrawBackground(Camera2D* camera, Vector2 screenSize);
 void DrawLimit(Entity* limit);
 void DrawDeathZone(Entity* deathZone);
+
+void InvalidateStaticLayer(StaticLayer* layer);
+void UpdateStaticLayer(StaticLayer* layer, Camera2D* camera, const Level* level, Color background);
+void DrawStaticLayer(const StaticLayer* layer);
+void UnloadStaticLayer(StaticLayer* layer);
 #endif //ARENA_H
@@ -1,70 +1,268 @@
 #include "assets.h"
+#include "atlas.h"
+#include "jobs.h"
 #include "raylib.h"
 
+#include <string.h>
+
 extern Texture TextureLibrary[TextureEnumSize];
+extern TextureAtlas textureAtlas;
 extern Sound SoundLibrary[SoundEnumSize];
+extern Font menuFont;
+
+static const char* TexturePaths[TextureEnumSize] = {
+    [t_block_idle] = "assets/block_idle.png",
+    [t_box] = "assets/box.png",
+    [t_ball] = "assets/ball.png",
+    [t_wall_left] = "assets/wallL.png",
+    [t_wall_left_top] = "assets/wallLTop.png",
+    [t_wall_right] = "assets/wallR.png",
+    [t_wall_right_top] = "assets/wallRTop.png",
+    [t_ceiling_left] = "assets/ceilL.png",
+    [t_ceiling_mid] = "assets/ceilMid.png",
+    [t_ceiling_right] = "assets/ceilR.png",
+    [t_bg_ground] = "assets/bg_ground.png",
+    [t_bg_view] = "assets/bg_view.png",
+    [t_bg_sky] = "assets/bg_sky.png",
+    [t_target_rest] = "assets/target_rest.png",
+    [t_target_awake] = "assets/target_awake.png",
+    [t_limit] = "assets/limit.png",
+    [t_limit_end] = "assets/limit_end.png",
+    [t_paddle_left] = "assets/paddleL.png",
+    [t_paddle_mid] = "assets/paddleMid.png",
+    [t_paddle_right] = "assets/paddleR.png",
+    [t_ui_number_0] = "assets/UI/hud_character_0.png",
+    [t_ui_number_1] = "assets/UI/hud_character_1.png",
+    [t_ui_number_2] = "assets/UI/hud_character_2.png",
+    [t_ui_number_3] = "assets/UI/hud_character_3.png",
+    [t_ui_number_4] = "assets/UI/hud_character_4.png",
+    [t_ui_number_5] = "assets/UI/hud_character_5.png",
+    [t_ui_number_6] = "assets/UI/hud_character_6.png",
+    [t_ui_number_7] = "assets/UI/hud_character_7.png",
+    [t_ui_number_8] = "assets/UI/hud_character_8.png",
+    [t_ui_number_9] = "assets/UI/hud_character_9.png",
+    [t_ui_button_color] = "assets/UI/button_color.png",
+    [t_ui_button_gray] = "assets/UI/button_gray.png",
+    [t_ui_heart] = "assets/UI/heart.png",
+    [t_ui_heart_empty] = "assets/UI/heart_empty.png",
+    [t_ui_coin] = "assets/UI/coin.png",
+    [t_ui_star] = "assets/UI/star.png",
+    [t_ui_star_empty] = "assets/UI/star_outline.png",
+};
+
+static const char* SoundPaths[SoundEnumSize] = {
+    [s_paddle_1] = "assets/paddle1.ogg",
+    [s_paddle_2] = "assets/paddle2.ogg",
+    [s_paddle_3] = "assets/paddle3.ogg",
+    [s_target_1] = "assets/target1.ogg",
+    [s_target_2] = "assets/target2.ogg",
+    [s_target_3] = "assets/target3.ogg",
+    [s_target_4] = "assets/target4.ogg",
+};
+
+static Texture TextureMetrics(Image image) {
+    return (Texture){
+        .id = 0,
+        .width = image.width,
+        .height = image.height,
+        .mipmaps = image.mipmaps,
+        .format = image.format
+    };
+}
+
+static const char* MenuFontPath = "assets/UI/Kenney Future Narrow.ttf";
+// What LoadFont rasterizes a TTF at: 32 pixels, the 95 printable ASCII glyphs, 4 pixels apart in the atlas
+constexpr int MENU_FONT_SIZE = 32;
+constexpr int MENU_FONT_GLYPHS = 95;
+constexpr int MENU_FONT_PADDING = 4;
+
+// Every texture, then every sound, then the menu font
+constexpr int ASSET_COUNT = TextureEnumSize + SoundEnumSize + 1;
+// How long a loading frame may spend decoding before it is drawn
+static const double LOADING_FRAME_BUDGET = 1.0 / 120.0;
+
+/*
+ * Loading is split in two: decoding files into images, waves and glyphs, which only needs the CPU and runs on
+ * the job system a batch at a time, and turning those into textures and sounds, which has to happen on the main
+ * thread. LoadAssetsStep does a frame's worth of it at a time, so the window can draw a loading screen meanwhile.
+ */
+typedef struct AssetLoader {
+    Image images[TextureEnumSize];
+    Wave waves[SoundEnumSize];
+    Font font;
+    Image fontAtlas;
+    // Assets decoded so far, in the order above. The next batch starts here.
+    int decoded;
+    bool done;
+    double startTime;
+} AssetLoader;
+
+static AssetLoader loader = { 0 };
+
+static void DecodeAsset(AssetLoader* assets, int index) {
+    if (index < TextureEnumSize) {
+        assets->images[index] = LoadImage(TexturePaths[index]);
+        ImageFormat(&assets->images[index], PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+        TextureLibrary[index] = TextureMetrics(assets->images[index]);
+        return;
+    }
+    index -= TextureEnumSize;
+    if (index < SoundEnumSize) {
+        assets->waves[index] = LoadWave(SoundPaths[index]);
+        return;
+    }
+
+    int dataSize = 0;
+    unsigned char* data = LoadFileData(MenuFontPath, &dataSize);
+    if (data == nullptr)
+        return;
+    Font font = { .baseSize = MENU_FONT_SIZE, .glyphCount = MENU_FONT_GLYPHS, .glyphPadding = MENU_FONT_PADDING };
+    font.glyphs = LoadFontData(data, dataSize, MENU_FONT_SIZE, nullptr, MENU_FONT_GLYPHS, FONT_DEFAULT);
+    UnloadFileData(data);
+    if (font.glyphs == nullptr)
+        return;
+    assets->fontAtlas = GenImageFontAtlas(font.glyphs, &font.recs, font.glyphCount, font.baseSize, font.glyphPadding, 0);
+    // As LoadFontEx does: the glyphs come out as bare grayscale, and ImageTextEx draws these images,
+    // so swap them for their white, alpha-blended copies in the atlas
+    for (int i = 0; i < font.glyphCount; i++) {
+        UnloadImage(font.glyphs[i].image);
+        font.glyphs[i].image = ImageFromImage(assets->fontAtlas, font.recs[i]);
+    }
+    assets->font = font;
+}
+
+/**
+ * Decode a batch of assets. Every asset has its own slot in the loader, so the jobs share nothing.
+ * @param context The loader, whose decoded count is the index of the batch's first asset
+ */
+static void DecodeAssets(int startIndex, int endIndex, uint32_t workerIndex, void* context) {
+    AssetLoader* assets = context;
+    for (int i = startIndex; i < endIndex; i++)
+        DecodeAsset(assets, assets->decoded + i);
+}
+
+/**
+ * Turn everything decoded into the sprite atlas, sounds and the menu font, and free what was decoded.
+ * Needs the GL context, so runs on the main thread.
+ */
+static void UploadAssets(AssetLoader* assets) {
+    if (!BuildTextureAtlas(&textureAtlas, assets->images, TextureEnumSize, ATLAS_PAGE_SIZE))
+        TraceLog(LOG_ERROR, "ASSETS: Sprites do not fit in %d atlas pages", ATLAS_MAX_PAGES);
+    for(int i = 0; i < TextureEnumSize; i++){
+        UnloadImage(assets->images[i]);
+    }
+    for(int i = 0; i < SoundEnumSize; i++){
+        SoundLibrary[i] = LoadSoundFromWave(assets->waves[i]);
+        UnloadWave(assets->waves[i]);
+    }
+
+    if (assets->font.glyphs != nullptr) {
+        assets->font.texture = LoadTextureFromImage(assets->fontAtlas);
+        UnloadImage(assets->fontAtlas);
+        menuFont = assets->font;
+    }
+    else {
+        TraceLog(LOG_WARNING, "ASSETS: Could not load %s, using the default font", MenuFontPath);
+        menuFont = GetFontDefault();
+    }
+    memset(assets->images, 0, sizeof assets->images);
+    memset(assets->waves, 0, sizeof assets->waves);
+    assets->font = (Font){ 0 };
+    assets->fontAtlas = (Image){ 0 };
+}
+
+/**
+ * Load a bit more of every sound, texture and the menu font. Call once per frame, from the thread that
+ * opened the window, until it returns true. Each call decodes batches of files across the job system
+ * for about half a frame, and the call after the last batch uploads them all.
+ * @return Whether every asset is loaded
+ */
+bool LoadAssetsStep(void) {
+    if (loader.done)
+        return true;
+    if (loader.decoded == 0)
+        loader.startTime = GetTime();
 
+    if (loader.decoded < ASSET_COUNT) {
+        double frameStart = GetTime();
+        // One file per worker, so a batch takes about as long as its largest file
+        int batchSize = JobsWorkerCount() > 1 ? JobsWorkerCount() : 1;
+        do {
+            int count = ASSET_COUNT - loader.decoded < batchSize ? ASSET_COUNT - loader.decoded : batchSize;
+            ParallelFor(count, 1, DecodeAssets, &loader);
+            loader.decoded += count;
+        } while (loader.decoded < ASSET_COUNT && GetTime() - frameStart < LOADING_FRAME_BUDGET);
+        // Uploading is left to the next frame, so the loading screen shows the decoding finished
+        return false;
+    }
+
+    UploadAssets(&loader);
+    loader.done = true;
+    TraceLog(LOG_INFO, "ASSETS: %d assets loaded in %.1f ms", ASSET_COUNT, (GetTime() - loader.startTime) * 1000.0);
+    return true;
+}
+
+/**
+ * @return How much of the loading is done, from 0 to 1
+ */
+float AssetLoadingProgress(void) {
+    if (loader.done)
+        return 1.0f;
+    // The upload counts as one more step
+    return (float)loader.decoded / (float)(ASSET_COUNT + 1);
+}
+
+/**
+ * Load every sound, texture and the menu font at once.
+ * TextureLibrary only keeps each sprite's dimensions; sprites are drawn through DrawSprite.
+ */
 void LoadAssetLibraries(){
-    TextureLibrary[t_block_idle] = LoadTexture("assets/block_idle.png");
-	TextureLibrary[t_box] = LoadTexture("assets/box.png");
-	TextureLibrary[t_ball] = LoadTexture("assets/ball.png");
-    
-	TextureLibrary[t_wall_left] = LoadTexture("assets/wallL.png");
-	TextureLibrary[t_wall_left_top] = LoadTexture("assets/wallLTop.png");
-	TextureLibrary[t_wall_right] = LoadTexture("assets/wallR.png");
-	TextureLibrary[t_wall_right_top] = LoadTexture("assets/wallRTop.png");
-
-	TextureLibrary[t_ceiling_left] = LoadTexture("assets/ceilL.png");
-	TextureLibrary[t_ceiling_mid] = LoadTexture("assets/ceilMid.png");
-	TextureLibrary[t_ceiling_right] = LoadTexture("assets/ceilR.png");
-
-	TextureLibrary[t_bg_ground] = LoadTexture("assets/bg_ground.png");
-	TextureLibrary[t_bg_view] = LoadTexture("assets/bg_view.png");
-	TextureLibrary[t_bg_sky] = LoadTexture("assets/bg_sky.png");
-
-	TextureLibrary[t_target_rest] = LoadTexture("assets/target_rest.png");
-	TextureLibrary[t_target_awake] = LoadTexture("assets/target_awake.png");
-
-	TextureLibrary[t_limit] = LoadTexture("assets/limit.png");
-	TextureLibrary[t_limit_end] = LoadTexture("assets/limit_end.png");
-
-	TextureLibrary[t_paddle_left] = LoadTexture("assets/paddleL.png");
-	TextureLibrary[t_paddle_mid] = LoadTexture("assets/paddleMid.png");
-	TextureLibrary[t_paddle_right] = LoadTexture("assets/paddleR.png");
-
-	TextureLibrary[t_ui_number_0] = LoadTexture("assets/UI/hud_character_0.png");
-	TextureLibrary[t_ui_number_1] = LoadTexture("assets/UI/hud_character_1.png");
-	TextureLibrary[t_ui_number_2] = LoadTexture("assets/UI/hud_character_2.png");
-	TextureLibrary[t_ui_number_3] = LoadTexture("assets/UI/hud_character_3.png");
-	TextureLibrary[t_ui_number_4] = LoadTexture("assets/UI/hud_character_4.png");
-	TextureLibrary[t_ui_number_5] = LoadTexture("assets/UI/hud_character_5.png");
-	TextureLibrary[t_ui_number_6] = LoadTexture("assets/UI/hud_character_6.png");
-	TextureLibrary[t_ui_number_7] = LoadTexture("assets/UI/hud_character_7.png");
-	TextureLibrary[t_ui_number_8] = LoadTexture("assets/UI/hud_character_8.png");
-	TextureLibrary[t_ui_number_9] = LoadTexture("assets/UI/hud_character_9.png");
-
-	TextureLibrary[t_ui_button_color] = LoadTexture("assets/UI/button_color.png");
-	TextureLibrary[t_ui_button_gray] = LoadTexture("assets/UI/button_gray.png");
-	TextureLibrary[t_ui_heart] = LoadTexture("assets/UI/heart.png");
-	TextureLibrary[t_ui_heart_empty] = LoadTexture("assets/UI/heart_empty.png");
-	TextureLibrary[t_ui_coin] = LoadTexture("assets/UI/coin.png");
-	TextureLibrary[t_ui_star] = LoadTexture("assets/UI/star.png");
-	TextureLibrary[t_ui_star_empty] = LoadTexture("assets/UI/star_outline.png");
-    
-    SoundLibrary[s_paddle_1] = LoadSound("assets/paddle1.ogg");
-	SoundLibrary[s_paddle_2] = LoadSound("assets/paddle2.ogg");
-	SoundLibrary[s_paddle_3] = LoadSound("assets/paddle3.ogg");
-	SoundLibrary[s_target_1] = LoadSound("assets/target1.ogg");
-	SoundLibrary[s_target_2] = LoadSound("assets/target2.ogg");
-	SoundLibrary[s_target_3] = LoadSound("assets/target3.ogg");
-	SoundLibrary[s_target_4] = LoadSound("assets/target4.ogg");
+    while (!LoadAssetsStep()) {}
+}
+
+static void MeasureTextures(int startIndex, int endIndex, uint32_t workerIndex, void* context) {
+    for(int i = startIndex; i < endIndex; i++){
+        Image image = LoadImage(TexturePaths[i]);
+        TextureLibrary[i] = TextureMetrics(image);
+        UnloadImage(image);
+    }
+}
+
+/**
+ * Fill TextureLibrary with the dimensions of every texture without touching the GPU.
+ * The world is laid out from texture sizes, so this is all a headless simulation needs.
+ * The textures' ids stay 0, so they must never be drawn or unloaded.
+ */
+void LoadAssetMetrics(){
+    ParallelFor(TextureEnumSize, 4, MeasureTextures, nullptr);
 }
 
+/**
+ * Free every asset, and whatever was decoded but not uploaded yet if loading was cut short.
+ */
 void UnloadAssetLibraries(){
-    for(int i = 0; i < TextureEnumSize; i++){
-        UnloadTexture(TextureLibrary[i]);
+    if (!loader.done) {
+        for(int i = 0; i < TextureEnumSize; i++){
+            UnloadImage(loader.images[i]);
+        }
+        for(int i = 0; i < SoundEnumSize; i++){
+            UnloadWave(loader.waves[i]);
+        }
+        if (loader.font.glyphs != nullptr) {
+            UnloadImage(loader.fontAtlas);
+            UnloadFont(loader.font);
+        }
+    }
+    else {
+        // Leaves the default font alone
+        UnloadFont(menuFont);
     }
+    menuFont = (Font){ 0 };
+    loader = (AssetLoader){ 0 };
+
+    UnloadTextureAtlas(&textureAtlas);
     for(int i = 0; i < SoundEnumSize; i++){
         UnloadSound(SoundLibrary[i]);
+        SoundLibrary[i] = (Sound){ 0 };
     }
-}
\ No newline at end of file
+}
@@ -62,7 +62,10 @@ typedef struct InterfaceAssets {
 
 } InterfaceAssets;
 
+bool LoadAssetsStep(void);
+float AssetLoadingProgress(void);
 void LoadAssetLibraries(void);
+void LoadAssetMetrics(void);
 void UnloadAssetLibraries(void);
 
 InterfaceAssets LoadInterfaceAssets(void);
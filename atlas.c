@@ -0,0 +1,113 @@
+//
+// Created by frick on 2025-07-23.
+//
+
+#include "atlas.h"
+
+#include <string.h>
+
+// Empty pixels around every sprite, filled with copies of its edges and corners so that filtering
+// does not bleed neighbouring sprites into it. The padding halves with every mipmap level, so it only
+// holds down to the third level (1/4 size); sprites drawn smaller than that may pick up their neighbours' edges.
+constexpr int ATLAS_PADDING = 4;
+
+typedef struct Shelf {
+    int y;
+    int height;
+    int x;
+} Shelf;
+
+// Repeat the outermost pixels of a sprite into its padding, and its corner pixels into the padding's corners,
+// which rotated sprites sample too
+static void ExtrudeEdges(Image* page, Image sprite, Rectangle at) {
+    float w = (float)sprite.width, h = (float)sprite.height, pad = (float)ATLAS_PADDING;
+    ImageDraw(page, sprite, (Rectangle){0, 0, 1, h}, (Rectangle){at.x - pad, at.y, pad, h}, WHITE);
+    ImageDraw(page, sprite, (Rectangle){w - 1, 0, 1, h}, (Rectangle){at.x + w, at.y, pad, h}, WHITE);
+    ImageDraw(page, sprite, (Rectangle){0, 0, w, 1}, (Rectangle){at.x, at.y - pad, w, pad}, WHITE);
+    ImageDraw(page, sprite, (Rectangle){0, h - 1, w, 1}, (Rectangle){at.x, at.y + h, w, pad}, WHITE);
+    ImageDraw(page, sprite, (Rectangle){0, 0, 1, 1}, (Rectangle){at.x - pad, at.y - pad, pad, pad}, WHITE);
+    ImageDraw(page, sprite, (Rectangle){w - 1, 0, 1, 1}, (Rectangle){at.x + w, at.y - pad, pad, pad}, WHITE);
+    ImageDraw(page, sprite, (Rectangle){0, h - 1, 1, 1}, (Rectangle){at.x - pad, at.y + h, pad, pad}, WHITE);
+    ImageDraw(page, sprite, (Rectangle){w - 1, h - 1, 1, 1}, (Rectangle){at.x + w, at.y + h, pad, pad}, WHITE);
+}
+
+/**
+ * Pack images into mipmapped atlas pages, tallest first, on shelves running left to right.
+ * @param atlas Receives the pages and where each image was placed
+ * @param images The images to pack, in TextureEnum order. They are copied and can be unloaded afterwards.
+ * @param imageCount Number of images, at most TextureEnumSize
+ * @param pageSize Width and height of every page, a power of two so that mipmaps work everywhere
+ * @return False if an image does not fit on a page, or the images need more than ATLAS_MAX_PAGES pages
+ */
+bool BuildTextureAtlas(TextureAtlas* atlas, const Image* images, int imageCount, int pageSize) {
+    memset(atlas, 0, sizeof *atlas);
+    // Tallest first; a stable insertion sort is plenty for a few dozen images
+    int order[TextureEnumSize];
+    for (int i = 0; i < imageCount; i++) {
+        int j = i;
+        while (j > 0 && images[order[j - 1]].height < images[i].height) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    Image pageImages[ATLAS_MAX_PAGES] = { 0 };
+    int page = -1;
+    Shelf shelf = { 0 };
+    bool ok = true;
+    for (int k = 0; k < imageCount && ok; k++) {
+        const Image* image = images + order[k];
+        int w = image->width + 2 * ATLAS_PADDING;
+        int h = image->height + 2 * ATLAS_PADDING;
+        if (w > pageSize || h > pageSize) {
+            ok = false;
+            break;
+        }
+
+        if (page >= 0 && shelf.x + w > pageSize) {
+            shelf.y += shelf.height;
+            shelf.x = 0;
+            shelf.height = 0;
+        }
+        if (page < 0 || shelf.y + h > pageSize) {
+            if (++page >= ATLAS_MAX_PAGES) {
+                ok = false;
+                break;
+            }
+            pageImages[page] = GenImageColor(pageSize, pageSize, BLANK);
+            shelf = (Shelf){ 0 };
+        }
+        // Sorted by height, so the first image on a shelf is its tallest
+        if (shelf.height == 0)
+            shelf.height = h;
+
+        Rectangle at = {
+            (float)(shelf.x + ATLAS_PADDING),
+            (float)(shelf.y + ATLAS_PADDING),
+            (float)image->width,
+            (float)image->height
+        };
+        ImageDraw(&pageImages[page], *image, (Rectangle){0, 0, at.width, at.height}, at, WHITE);
+        ExtrudeEdges(&pageImages[page], *image, at);
+        atlas->sprites[order[k]] = (AtlasSprite){page, at};
+        shelf.x += w;
+    }
+
+    for (int i = 0; i <= page && i < ATLAS_MAX_PAGES; i++) {
+        if (ok) {
+            atlas->pages[i] = LoadTextureFromImage(pageImages[i]);
+            GenTextureMipmaps(&atlas->pages[i]);
+            SetTextureFilter(atlas->pages[i], TEXTURE_FILTER_TRILINEAR);
+        }
+        UnloadImage(pageImages[i]);
+    }
+    atlas->pageCount = ok ? page + 1 : 0;
+    return ok;
+}
+
+void UnloadTextureAtlas(TextureAtlas* atlas) {
+    for (int i = 0; i < atlas->pageCount; i++)
+        UnloadTexture(atlas->pages[i]);
+    memset(atlas, 0, sizeof *atlas);
+}
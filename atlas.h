@@ -0,0 +1,36 @@
+//
+// Created by frick on 2025-07-23.
+//
+
+#ifndef ATLAS_H
+#define ATLAS_H
+#include <raylib.h>
+
+#include "assets.h"
+
+constexpr int ATLAS_MAX_PAGES = 4;
+// 2048 is the largest texture size every WebGL implementation supports
+constexpr int ATLAS_PAGE_SIZE = 2048;
+
+/**
+ * Where a sprite ended up: which page, and the pixels it covers on that page.
+ */
+typedef struct AtlasSprite {
+    int page;
+    Rectangle source;
+} AtlasSprite;
+
+/**
+ * Every sprite in TextureLibrary, packed into as few textures ("pages") as they fit in.
+ * Indexed by TextureEnum.
+ */
+typedef struct TextureAtlas {
+    int pageCount;
+    Texture pages[ATLAS_MAX_PAGES];
+    AtlasSprite sprites[TextureEnumSize];
+} TextureAtlas;
+
+bool BuildTextureAtlas(TextureAtlas* atlas, const Image* images, int imageCount, int pageSize);
+void UnloadTextureAtlas(TextureAtlas* atlas);
+
+#endif //ATLAS_H
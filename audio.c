@@ -0,0 +1,137 @@
+//
+// Created by frick on 2025-07-27.
+//
+
+#include "audio.h"
+#include "assets.h"
+#include "raylib.h"
+
+#include <stdint.h>
+
+extern Sound SoundLibrary[SoundEnumSize];
+
+/*
+ * Every effect has AUDIO_VOICES voices, and every voice an alias of each of the effect's variants, so voices
+ * share the sample data but not their playback. Hits are queued during the frame's ticks and merged per effect,
+ * the loudest one winning, then FlushSounds starts at most one voice per effect.
+ */
+
+constexpr int MAX_VARIANTS = 4;
+
+typedef struct EffectVoices {
+    // The effect's variants are SoundLibrary[firstSound] onwards
+    int firstSound;
+    int variantCount;
+    Sound aliases[MAX_VARIANTS][AUDIO_VOICES];
+    // The variant each voice last played, -1 if it never has, and how loud
+    int variants[AUDIO_VOICES];
+    float volumes[AUDIO_VOICES];
+    // When each voice was started, in flushes, to steal the oldest of equally loud voices
+    uint64_t started[AUDIO_VOICES];
+
+    bool pending;
+    int pendingVariant;
+    float pendingVolume;
+} EffectVoices;
+
+static EffectVoices effects[SoundEffectSize] = {
+    [EFFECT_PADDLE] = { .firstSound = s_paddle_1, .variantCount = 3 },
+    [EFFECT_TARGET] = { .firstSound = s_target_1, .variantCount = 4 },
+};
+static uint64_t flushCount = 0;
+static bool voicesReady = false;
+
+/**
+ * Create every effect's voices. Call once the audio device is open and the SoundLibrary is loaded.
+ */
+void InitVoices(void) {
+    if (!IsAudioDeviceReady())
+        return;
+    for (int e = 0; e < SoundEffectSize; e++) {
+        EffectVoices* effect = effects + e;
+        for (int v = 0; v < effect->variantCount; v++)
+            for (int voice = 0; voice < AUDIO_VOICES; voice++)
+                effect->aliases[v][voice] = LoadSoundAlias(SoundLibrary[effect->firstSound + v]);
+        for (int voice = 0; voice < AUDIO_VOICES; voice++)
+            effect->variants[voice] = -1;
+        effect->pending = false;
+    }
+    voicesReady = true;
+}
+
+/**
+ * Free the voices. Call before the SoundLibrary they alias is unloaded.
+ */
+void UnloadVoices(void) {
+    if (!voicesReady)
+        return;
+    for (int e = 0; e < SoundEffectSize; e++) {
+        EffectVoices* effect = effects + e;
+        for (int v = 0; v < effect->variantCount; v++)
+            for (int voice = 0; voice < AUDIO_VOICES; voice++)
+                UnloadSoundAlias(effect->aliases[v][voice]);
+    }
+    voicesReady = false;
+}
+
+/**
+ * Ask for a sound to be played at the end of the frame. Of all the sounds queued for an effect in one frame,
+ * only the loudest is played.
+ * @param variant Which of the effect's sounds, below its variant count
+ * @param volume 0 to 1
+ */
+void QueueSound(enum SoundEffect effect, int variant, float volume) {
+    EffectVoices* voices = effects + effect;
+    if (voices->pending && volume <= voices->pendingVolume)
+        return;
+    voices->pending = true;
+    voices->pendingVariant = variant;
+    voices->pendingVolume = volume;
+}
+
+/**
+ * @return A voice that is not playing, or else the quietest and then oldest, or -1 if every voice is louder
+ */
+static int PickVoice(const EffectVoices* effect, float volume) {
+    int picked = -1;
+    for (int voice = 0; voice < AUDIO_VOICES; voice++) {
+        int variant = effect->variants[voice];
+        if (variant < 0 || !IsSoundPlaying(effect->aliases[variant][voice]))
+            return voice;
+        if (effect->volumes[voice] > volume)
+            continue;
+        if (picked < 0 || effect->volumes[voice] < effect->volumes[picked]
+            || (effect->volumes[voice] == effect->volumes[picked] && effect->started[voice] < effect->started[picked]))
+            picked = voice;
+    }
+    return picked;
+}
+
+/**
+ * Play what was queued this frame, one voice per effect at most. Call once per frame.
+ */
+void FlushSounds(void) {
+    flushCount++;
+    for (int e = 0; e < SoundEffectSize; e++) {
+        EffectVoices* effect = effects + e;
+        if (!effect->pending)
+            continue;
+        effect->pending = false;
+        if (!voicesReady)
+            continue;
+
+        int voice = PickVoice(effect, effect->pendingVolume);
+        if (voice < 0)
+            continue;
+        int playing = effect->variants[voice];
+        if (playing >= 0)
+            StopSound(effect->aliases[playing][voice]);
+
+        Sound sound = effect->aliases[effect->pendingVariant][voice];
+        SetSoundVolume(sound, effect->pendingVolume);
+        PlaySound(sound);
+        effect->variants[voice] = effect->pendingVariant;
+        effect->volumes[voice] = effect->pendingVolume;
+        effect->started[voice] = flushCount;
+    }
+}
@@ -0,0 +1,25 @@
+//
+// Created by frick on 2025-07-27.
+//
+
+#ifndef AUDIO_H
+#define AUDIO_H
+
+// Sounds played at once per effect. Past that, a louder hit steals the quietest voice.
+constexpr int AUDIO_VOICES = 4;
+
+/**
+ * A kind of sound, played as one of several variants from the SoundLibrary.
+ */
+enum SoundEffect {
+    EFFECT_PADDLE,
+    EFFECT_TARGET,
+    SoundEffectSize
+};
+
+void InitVoices(void);
+void UnloadVoices(void);
+void QueueSound(enum SoundEffect effect, int variant, float volume);
+void FlushSounds(void);
+
+#endif //AUDIO_H
@@ -0,0 +1,320 @@
+//
+// Created by frick on 2025-07-22.
+//
+
+#include "balls.h"
+#include "box2d/box2d.h"
+#include "box2d/math_functions.h"
+#include "assets.h"
+#include "dispatch.h"
+#include "interpolation.h"
+#include "jobs.h"
+#include "rlgl.h"
+#include "sprites.h"
+
+#include <math.h>
+
+extern Texture TextureLibrary[TextureEnumSize];
+
+// Balls per trail job. Below this, handing the work to another thread costs more than doing it.
+constexpr int BALL_TRAIL_JOB_SIZE = 64;
+
+/**
+ * Empty the pool. Call whenever the world is rebuilt, as the old bodies went with the old world.
+ * @param pool The pool to reset
+ * @param worldId The world new balls are created in
+ */
+void InitBallPool(BallPool* pool, b2WorldId worldId) {
+    pool->worldId = worldId;
+    pool->activeCount = 0;
+    pool->freeCount = BALL_POOL_CAPACITY;
+    for (int i = 0; i < BALL_POOL_CAPACITY; i++) {
+        pool->bodyIds[i] = b2_nullBodyId;
+        pool->shapeIds[i] = b2_nullShapeId;
+        pool->states[i] = BALL_FREE;
+        // Slot 0 is handed out first
+        pool->freeSlots[i] = BALL_POOL_CAPACITY - 1 - i;
+    }
+}
+
+static void CreateBallBody(BallPool* pool, int slot, float radius) {
+    b2Circle circle = {b2Vec2_zero, radius};
+
+    b2BodyDef ballBodyDef = b2DefaultBodyDef();
+    ballBodyDef.type = b2_dynamicBody;
+    ballBodyDef.isBullet = true;
+    ballBodyDef.enableSleep = false;
+
+    b2BodyId bodyId = b2CreateBody(pool->worldId, &ballBodyDef);
+    b2ShapeDef ballShapeDef = b2DefaultShapeDef();
+    ballShapeDef.enableContactEvents = true;
+    ballShapeDef.enableHitEvents = true;
+    ballShapeDef.filter.categoryBits = BALL;
+    ballShapeDef.filter.maskBits = PADDLE | GROUND | BOX | TARGET;
+    ballShapeDef.userData = MakeShapeHandle(SHAPE_BALL, (uint32_t)slot);
+
+    b2ShapeId shapeId = b2CreateCircleShape(bodyId, &ballShapeDef, &circle);
+    b2Shape_SetRestitution(shapeId, 0.95f);
+
+    pool->bodyIds[slot] = bodyId;
+    pool->shapeIds[slot] = shapeId;
+    pool->radii[slot] = radius;
+}
+
+/**
+ * Put a ball into play, reusing the body of a despawned ball when there is one.
+ * @return The ball's slot, or -1 if the pool is full
+ */
+int SpawnBall(BallPool* pool, b2Vec2 position, b2Vec2 velocity, float radius, int sprite, Color color) {
+    if (pool->freeCount == 0)
+        return -1;
+    int slot = pool->freeSlots[--pool->freeCount];
+
+    if (B2_IS_NULL(pool->bodyIds[slot])) {
+        CreateBallBody(pool, slot, radius);
+    }
+    else {
+        b2Body_Enable(pool->bodyIds[slot]);
+        if (pool->radii[slot] != radius) {
+            b2Circle circle = {b2Vec2_zero, radius};
+            b2Shape_SetCircle(pool->shapeIds[slot], &circle);
+            pool->radii[slot] = radius;
+        }
+    }
+    b2BodyId bodyId = pool->bodyIds[slot];
+    b2Body_SetTransform(bodyId, position, b2MakeRot(0));
+    b2Body_SetLinearVelocity(bodyId, velocity);
+    b2Body_SetAngularVelocity(bodyId, 0.0f);
+    InterpolationSnap(bodyId);
+
+    pool->positions[slot] = position;
+    pool->colors[slot] = color;
+    pool->sprites[slot] = sprite;
+    pool->states[slot] = BALL_ACTIVE;
+    // Don't streak the trail from wherever this slot was last used
+    pool->trailHeads[slot] = 0;
+    for (int i = 0; i < BALL_TRACERS; i++)
+        pool->trails[slot][i] = position;
+
+    pool->activeIndex[slot] = pool->activeCount;
+    pool->active[pool->activeCount++] = slot;
+    return slot;
+}
+
+/**
+ * Take a ball out of play. Its body is disabled and kept for the next ball spawned into the slot.
+ */
+void DespawnBall(BallPool* pool, int slot) {
+    if (slot < 0 || slot >= BALL_POOL_CAPACITY || pool->states[slot] != BALL_ACTIVE)
+        return;
+    b2Body_Disable(pool->bodyIds[slot]);
+    pool->states[slot] = BALL_FREE;
+
+    // Swap the last active ball into the hole
+    int index = pool->activeIndex[slot];
+    int last = pool->active[--pool->activeCount];
+    pool->active[index] = last;
+    pool->activeIndex[last] = index;
+
+    pool->freeSlots[pool->freeCount++] = slot;
+}
+
+void DespawnAllBalls(BallPool* pool) {
+    while (pool->activeCount > 0)
+        DespawnBall(pool, pool->active[pool->activeCount - 1]);
+}
+
+static void RecordTrailRange(int startIndex, int endIndex, uint32_t workerIndex, void* context) {
+    BallPool* pool = context;
+    for (int i = startIndex; i < endIndex; i++) {
+        int slot = pool->active[i];
+        b2Vec2 position = b2Body_GetPosition(pool->bodyIds[slot]);
+        pool->positions[slot] = position;
+        int head = pool->trailHeads[slot] + 1;
+        if (head == BALL_TRACERS)
+            head = 0;
+        pool->trailHeads[slot] = head;
+        pool->trails[slot][head] = position;
+    }
+}
+
+/**
+ * Read every ball's position after a step and push it onto its trail. Call once per simulation tick.
+ */
+void RecordBallTrails(BallPool* pool) {
+    // Every slot is written by one job only, and reading body positions between steps is safe from any thread
+    ParallelFor(pool->activeCount, BALL_TRAIL_JOB_SIZE, RecordTrailRange, pool);
+}
+
+/**
+ * Find every ball whose center is inside an oriented box, using the positions from the last tick.
+ * @param box The box's transform
+ * @param extent The box's half extents
+ * @param slots Receives the slots found, room for BALL_POOL_CAPACITY
+ * @return How many balls were found
+ */
+int FindBallsInBox(const BallPool* pool, b2Transform box, b2Vec2 extent, int* slots) {
+    int count = 0;
+    for (int i = 0; i < pool->activeCount; i++) {
+        int slot = pool->active[i];
+        b2Vec2 local = b2InvTransformPoint(box, pool->positions[slot]);
+        if (fabsf(local.x) <= extent.x && fabsf(local.y) <= extent.y)
+            slots[count++] = slot;
+    }
+    return count;
+}
+
+/**
+ * @return The slot of the ball closest to the bottom of the screen, or -1 if none are in play
+ */
+int LowestBall(const BallPool* pool) {
+    int lowest = -1;
+    float lowestY = -INFINITY;
+    for (int i = 0; i < pool->activeCount; i++) {
+        int slot = pool->active[i];
+        if (pool->positions[slot].y > lowestY) {
+            lowestY = pool->positions[slot].y;
+            lowest = slot;
+        }
+    }
+    return lowest;
+}
+
+// Trail triangles are culled unless they are wound like raylib's own shapes
+static void TrailTriangle(Vector2 a, Color ca, Vector2 b, Color cb, Vector2 c, Color cc) {
+    float cross = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (cross > 0) {
+        Vector2 v = b; b = c; c = v;
+        Color t = cb; cb = cc; cc = t;
+    }
+    rlColor4ub(ca.r, ca.g, ca.b, ca.a); rlVertex2f(a.x, a.y);
+    rlColor4ub(cb.r, cb.g, cb.b, cb.a); rlVertex2f(b.x, b.y);
+    rlColor4ub(cc.r, cc.g, cc.b, cc.a); rlVertex2f(c.x, c.y);
+}
+
+/**
+ * Draw a trail as one strip of triangles, from the ball (full radius, opaque) to the oldest
+ * recorded position (no radius, transparent).
+ * @param head The ball's drawn position, which leads the recorded ones
+ */
+static void DrawBallTrail(const BallPool* pool, int slot, b2Vec2 head) {
+    const b2Vec2* trail = pool->trails[slot];
+    int trailHead = pool->trailHeads[slot];
+    float ballRadius = pool->radii[slot];
+    Color ballColor = pool->colors[slot];
+
+    // Consecutive trails share the mode and texture, so raylib keeps them in a single draw call
+    rlCheckRenderBatchLimit(6 * BALL_TRACERS);
+    rlBegin(RL_TRIANGLES);
+    b2Vec2 previous = head;
+    Vector2 previousLeft = {head.x, head.y}, previousRight = previousLeft;
+    Color previousColor = ballColor;
+    for (int i = 0; i < BALL_TRACERS; i++) {
+        b2Vec2 point = trail[(trailHead - i + BALL_TRACERS) % BALL_TRACERS];
+        b2Vec2 direction = b2Normalize(b2Sub(previous, point));
+        b2Vec2 normal = {-direction.y, direction.x};
+        float t = (float)(BALL_TRACERS - 1 - i) / BALL_TRACERS;
+        float radius = ballRadius * t;
+        Color color = ballColor;
+        color.b = (uint8_t)(color.b * t);
+        color.a = (uint8_t)(255 * t);
+        Vector2 left = {point.x + normal.x * radius, point.y + normal.y * radius};
+        Vector2 right = {point.x - normal.x * radius, point.y - normal.y * radius};
+        if (i == 0) {
+            // The strip starts across the head, facing the same way as the first segment
+            previousLeft = (Vector2){head.x + normal.x * ballRadius, head.y + normal.y * ballRadius};
+            previousRight = (Vector2){head.x - normal.x * ballRadius, head.y - normal.y * ballRadius};
+        }
+        TrailTriangle(previousLeft, previousColor, previousRight, previousColor, right, color);
+        TrailTriangle(previousLeft, previousColor, right, color, left, color);
+        previous = point;
+        previousLeft = left;
+        previousRight = right;
+        previousColor = color;
+    }
+    rlEnd();
+}
+
+/**
+ * Draw every ball in play. Each kind of primitive is drawn for all balls before the next,
+ * so the trails, fills and outlines each end up in one batch however many balls there are.
+ */
+void DrawBalls(const BallPool* pool) {
+    b2Transform transforms[BALL_POOL_CAPACITY];
+    for (int i = 0; i < pool->activeCount; i++)
+        transforms[i] = GetRenderTransform(pool->bodyIds[pool->active[i]]);
+
+    for (int i = 0; i < pool->activeCount; i++)
+        DrawBallTrail(pool, pool->active[i], transforms[i].p);
+
+    for (int i = 0; i < pool->activeCount; i++) {
+        int slot = pool->active[i];
+        DrawCircle(transforms[i].p.x, transforms[i].p.y, pool->radii[slot], pool->colors[slot]);
+    }
+    for (int i = 0; i < pool->activeCount; i++) {
+        int slot = pool->active[i];
+        DrawCircleLines(transforms[i].p.x, transforms[i].p.y, pool->radii[slot], WHITE);
+    }
+
+    for (int i = 0; i < pool->activeCount; i++) {
+        int slot = pool->active[i];
+        int sprite = pool->sprites[slot];
+        if (sprite == SPRITE_NONE)
+            continue;
+        float radius = pool->radii[slot];
+        b2Rot rotation = transforms[i].q;
+        float radians = b2Rot_GetAngle(rotation);
+        // Raylib rotates textures around the positional point it is given, meaning the top-left corner is the anchor.
+        // Therefore, we need to compensate by drawing a vector from the ball's center to its "top-left" "corner",
+        // rotating it by the rotation of the b2Body, and adding it to the position of the ball's center to
+        // get the appropriate coordinates for Raylib to draw.
+        b2Vec2 adj = b2RotateVector(rotation, (b2Vec2){-radius, -radius});
+        // The sprite is scaled to the ball's diameter
+        float scale = radius * 2.0f / TextureLibrary[sprite].width;
+        DrawSprite(sprite, (Vector2){transforms[i].p.x + adj.x, transforms[i].p.y + adj.y}, RAD2DEG * radians, scale, WHITE);
+    }
+}
+
+void CheckBallPaddleCollision(const BallPool* pool, int slot, Paddle* paddle, BallRayCastContext* context, float deltaTime) {
+    if(slot < 0 || context->shapeId.index1 != paddle->shapeId.index1)
+        return;
+    b2BodyId ballId = pool->bodyIds[slot];
+
+    b2Sweep sweepA, sweepB;
+    sweepA.c1 = b2Body_GetPosition(ballId);
+    sweepA.q1 = b2NormalizeRot(b2Body_GetRotation(ballId));
+    sweepA.c2 = b2MulAdd(b2Body_GetPosition(ballId), deltaTime, b2Body_GetLinearVelocity(ballId)); // extrapolated pos
+    b2Rot preRot = b2Body_GetRotation(ballId);
+    b2Rot rotDelta = b2MakeRot(deltaTime * b2Body_GetAngularVelocity(ballId));
+    b2Rot finalRot = b2NormalizeRot((b2Rot){preRot.c + rotDelta.c, preRot.s + rotDelta.s});
+    sweepA.q2 = finalRot;
+    sweepA.localCenter = b2Body_GetLocalCenterOfMass(ballId);
+
+    sweepB.c1 = b2Body_GetPosition(paddle->bodyId);
+    sweepB.q1 = b2NormalizeRot(b2Body_GetRotation(paddle->bodyId));
+    sweepB.c2 = b2MulAdd(b2Body_GetPosition(paddle->bodyId), deltaTime, b2Body_GetLinearVelocity(paddle->bodyId)); // extrapolated pos
+    b2Rot padPreRot = b2Body_GetRotation(paddle->bodyId);
+    b2Rot padRotDelta = b2MakeRot(deltaTime * b2Body_GetAngularVelocity(paddle->bodyId));
+    b2Rot padFinalRot = b2NormalizeRot((b2Rot){padPreRot.c + padRotDelta.c, padPreRot.s + padRotDelta.s});
+    sweepB.q2 = padFinalRot;
+    sweepB.localCenter = b2Body_GetLocalCenterOfMass(paddle->bodyId);
+
+    b2TOIInput input = { 0 };
+    input.proxyA = b2MakeProxy(&b2Vec2_zero, 1, pool->radii[slot]);
+    input.proxyB = paddle->proxy;
+    input.sweepA = sweepA;
+    input.sweepB = sweepB;
+    input.maxFraction = 1.0f;
+
+    b2TOIOutput output = b2TimeOfImpact(&input);
+    if (
+        (output.state == b2_toiStateHit ||
+         output.state == b2_toiStateOverlapped)&&
+        output.fraction < 1.0f && output.fraction > 0 && b2Body_GetLinearVelocity(ballId).y > 0.0f
+        ) {
+        b2Rot ballRot = b2Body_GetRotation(ballId);
+        b2Vec2 adjustment = b2MulSV(pool->radii[slot], context->normal);
+        b2Vec2 adjPos = b2Add(context->point, adjustment);
+        b2Body_SetTransform(ballId, adjPos, ballRot);
+    }
+}
@@ -0,0 +1,64 @@
+//
+// Created by frick on 2025-07-22.
+//
+
+#ifndef BALLS_H
+#define BALLS_H
+
+#include "box2d/types.h"
+#include "raylib.h"
+#include "entities.h"
+#include <stdint.h>
+
+constexpr int BALL_POOL_CAPACITY = 512;
+constexpr int BALL_TRACERS = 35;
+
+enum BallState {
+    BALL_FREE,
+    BALL_ACTIVE,
+};
+
+/**
+ * Every ball in the world, stored as parallel arrays indexed by slot.
+ * The per-tick work (trails, death zone tests, picking the ball to track) only walks the hot arrays.
+ * A despawned ball keeps its body, disabled, so respawning into its slot does not touch the broadphase
+ * until the body is enabled again.
+ */
+typedef struct BallPool {
+    b2WorldId worldId;
+
+    // Hot: read or written every tick
+    b2BodyId bodyIds[BALL_POOL_CAPACITY];
+    b2Vec2 positions[BALL_POOL_CAPACITY];
+    float radii[BALL_POOL_CAPACITY];
+    int trailHeads[BALL_POOL_CAPACITY];
+    uint8_t states[BALL_POOL_CAPACITY];
+
+    // Cold: read when drawing or spawning
+    b2ShapeId shapeIds[BALL_POOL_CAPACITY];
+    Color colors[BALL_POOL_CAPACITY];
+    int sprites[BALL_POOL_CAPACITY];
+    // Ring buffer of each ball's position over the last BALL_TRACERS ticks, trailHeads being the newest
+    b2Vec2 trails[BALL_POOL_CAPACITY][BALL_TRACERS];
+
+    // Slots in use, packed for iteration, and where in that list each slot is
+    int active[BALL_POOL_CAPACITY];
+    int activeIndex[BALL_POOL_CAPACITY];
+    int activeCount;
+
+    // Slots not in use, taken last in first out so the most recently used bodies are reused
+    int freeSlots[BALL_POOL_CAPACITY];
+    int freeCount;
+} BallPool;
+
+void InitBallPool(BallPool* pool, b2WorldId worldId);
+int SpawnBall(BallPool* pool, b2Vec2 position, b2Vec2 velocity, float radius, int sprite, Color color);
+void DespawnBall(BallPool* pool, int slot);
+void DespawnAllBalls(BallPool* pool);
+void RecordBallTrails(BallPool* pool);
+int FindBallsInBox(const BallPool* pool, b2Transform box, b2Vec2 extent, int* slots);
+int LowestBall(const BallPool* pool);
+void DrawBalls(const BallPool* pool);
+void CheckBallPaddleCollision(const BallPool* pool, int slot, Paddle* paddle, BallRayCastContext* context, float deltaTime);
+
+#endif //BALLS_H
@@ -0,0 +1,133 @@
+//
+// Created by frick on 2025-07-27.
+//
+
+#include "debris.h"
+#include "box2d/box2d.h"
+#include "interpolation.h"
+
+/*
+ * Debris bodies carry their slot + 1 as body user data, so box2d's move events can be mapped back to slots
+ * and told apart from the bodies that are not debris, whose user data is null.
+ */
+
+/**
+ * @return The bytes an arena needs for a pool of this many boxes
+ */
+size_t DebrisPoolSize(int capacity) {
+    return MEMARENA_SIZE(Entity, capacity) + MEMARENA_SIZE(uint8_t, capacity) + 4 * MEMARENA_SIZE(int, capacity);
+}
+
+/**
+ * Build an empty pool. Call whenever the world is rebuilt, as the old bodies went with the old world.
+ * @param arena Where the pool's arrays come from, with at least DebrisPoolSize(capacity) bytes left
+ * @param capacity The most boxes that can be in play at once
+ * @param worldId The world new boxes are created in
+ */
+void InitDebrisPool(DebrisPool* pool, MemArena* arena, int capacity, b2WorldId worldId) {
+    pool->worldId = worldId;
+    pool->capacity = capacity;
+    pool->entities = MEMARENA_ALLOC(arena, Entity, capacity);
+    pool->states = MEMARENA_ALLOC(arena, uint8_t, capacity);
+    pool->active = MEMARENA_ALLOC(arena, int, capacity);
+    pool->activeIndex = MEMARENA_ALLOC(arena, int, capacity);
+    pool->freeSlots = MEMARENA_ALLOC(arena, int, capacity);
+    pool->leaving = MEMARENA_ALLOC(arena, int, capacity);
+    pool->activeCount = 0;
+    pool->freeCount = capacity;
+    for (int i = 0; i < capacity; i++) {
+        pool->entities[i].bodyId = b2_nullBodyId;
+        pool->states[i] = DEBRIS_FREE;
+        // Slot 0 is handed out first
+        pool->freeSlots[i] = capacity - 1 - i;
+    }
+}
+
+/**
+ * Put a box into play, upright and at rest, reusing the body of a despawned box when there is one.
+ * @param extent The box's half extents. A reused body is resized if it was a different size.
+ * @return The box's slot, or -1 if the pool is full
+ */
+int SpawnDebris(DebrisPool* pool, b2Vec2 position, b2Vec2 extent, int sprite) {
+    if (pool->freeCount == 0)
+        return -1;
+    int slot = pool->freeSlots[--pool->freeCount];
+    Entity* entity = pool->entities + slot;
+
+    if (B2_IS_NULL(entity->bodyId)) {
+        *entity = CreatePhysicsBox(position, extent, sprite, slot, pool->worldId);
+        b2Body_SetUserData(entity->bodyId, (void*)(uintptr_t)(slot + 1));
+    }
+    else {
+        b2Body_Enable(entity->bodyId);
+        if (entity->extent.x != extent.x || entity->extent.y != extent.y) {
+            b2Polygon polygon = b2MakeBox(extent.x, extent.y);
+            b2Shape_SetPolygon(entity->shapeId, &polygon);
+            entity->extent = extent;
+        }
+        entity->sprite = sprite;
+        b2Body_SetTransform(entity->bodyId, position, b2Rot_identity);
+        b2Body_SetLinearVelocity(entity->bodyId, b2Vec2_zero);
+        b2Body_SetAngularVelocity(entity->bodyId, 0.0f);
+        b2Body_SetAwake(entity->bodyId, true);
+        InterpolationSnap(entity->bodyId);
+    }
+    pool->states[slot] = DEBRIS_ACTIVE;
+
+    pool->activeIndex[slot] = pool->activeCount;
+    pool->active[pool->activeCount++] = slot;
+    return slot;
+}
+
+/**
+ * Take a box out of play. Its body is disabled, which also takes it out of the broadphase,
+ * and kept for the next box spawned into the slot.
+ */
+void DespawnDebris(DebrisPool* pool, int slot) {
+    if (slot < 0 || slot >= pool->capacity || pool->states[slot] != DEBRIS_ACTIVE)
+        return;
+    b2Body_Disable(pool->entities[slot].bodyId);
+    pool->states[slot] = DEBRIS_FREE;
+
+    // Swap the last active box into the hole
+    int index = pool->activeIndex[slot];
+    int last = pool->active[--pool->activeCount];
+    pool->active[index] = last;
+    pool->activeIndex[last] = index;
+
+    pool->freeSlots[pool->freeCount++] = slot;
+}
+
+void DespawnAllDebris(DebrisPool* pool) {
+    while (pool->activeCount > 0)
+        DespawnDebris(pool, pool->active[pool->activeCount - 1]);
+}
+
+/**
+ * Despawn every box that left an area during the last step. Only the bodies that moved are looked at,
+ * through box2d's move events, so boxes at rest or asleep cost nothing here.
+ * Call right after b2World_Step.
+ * @param bounds Boxes whose centers are outside this are despawned
+ * @return How many boxes were despawned
+ */
+int DespawnDebrisOutside(DebrisPool* pool, b2AABB bounds) {
+    b2BodyEvents events = b2World_GetBodyEvents(pool->worldId);
+    int count = 0;
+    for (int i = 0; i < events.moveCount; i++) {
+        const b2BodyMoveEvent* event = events.moveEvents + i;
+        int slot = (int)(uintptr_t)event->userData - 1;
+        if (slot < 0 || slot >= pool->capacity)
+            continue;
+        b2Vec2 p = event->transform.p;
+        if (p.x < bounds.lowerBound.x || p.x > bounds.upperBound.x || p.y < bounds.lowerBound.y || p.y > bounds.upperBound.y)
+            pool->leaving[count++] = slot;
+    }
+    for (int i = 0; i < count; i++)
+        DespawnDebris(pool, pool->leaving[i]);
+    return count;
+}
+
+void DrawDebris(const DebrisPool* pool) {
+    for (int i = 0; i < pool->activeCount; i++)
+        DrawEntity(pool->entities + pool->active[i]);
+}
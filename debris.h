@@ -0,0 +1,52 @@
+//
+// Created by frick on 2025-07-27.
+//
+
+#ifndef DEBRIS_H
+#define DEBRIS_H
+
+#include "box2d/types.h"
+#include "entities.h"
+#include "memarena.h"
+#include <stdint.h>
+
+enum DebrisState {
+    DEBRIS_FREE,
+    DEBRIS_ACTIVE,
+};
+
+/**
+ * Loose dynamic boxes, in a pool sized when the world is built. Like the ball pool, a despawned box keeps its body,
+ * disabled, and the next box spawned into the slot reuses it. Debris is allowed to sleep, so a resting pile costs
+ * the solver nothing until something wakes it.
+ * The arrays are carved from an arena owned by the caller.
+ */
+typedef struct DebrisPool {
+    b2WorldId worldId;
+    int capacity;
+
+    Entity* entities;
+    uint8_t* states;
+
+    // Slots in use, packed for iteration, and where in that list each slot is
+    int* active;
+    int* activeIndex;
+    int activeCount;
+
+    // Slots not in use, taken last in first out so the most recently used bodies are reused
+    int* freeSlots;
+    int freeCount;
+
+    // Slots found out of bounds after a step, despawned once box2d's events have been read
+    int* leaving;
+} DebrisPool;
+
+size_t DebrisPoolSize(int capacity);
+void InitDebrisPool(DebrisPool* pool, MemArena* arena, int capacity, b2WorldId worldId);
+int SpawnDebris(DebrisPool* pool, b2Vec2 position, b2Vec2 extent, int sprite);
+void DespawnDebris(DebrisPool* pool, int slot);
+void DespawnAllDebris(DebrisPool* pool);
+int DespawnDebrisOutside(DebrisPool* pool, b2AABB bounds);
+void DrawDebris(const DebrisPool* pool);
+
+#endif //DEBRIS_H
@@ -0,0 +1,85 @@
+//
+// Created by frick on 2025-07-16.
+//
+
+#include "dispatch.h"
+#include <box2d/box2d.h>
+
+// The low byte of a shape handle is its kind, the rest is the owner's index
+constexpr int SHAPE_KIND_BITS = 8;
+
+/**
+ * Pack a shape's kind and owner index into a value suitable for b2ShapeDef.userData.
+ * @param kind What the shape belongs to
+ * @param index Which one of those it belongs to
+ * @return The user data to store on the shape
+ */
+void* MakeShapeHandle(enum ShapeKind kind, uint32_t index) {
+    return (void*)(((uintptr_t)index << SHAPE_KIND_BITS) | (uintptr_t)kind);
+}
+
+/**
+ * Unpack a shape's user data. Shapes that no longer exist come back as SHAPE_NONE.
+ * @param shapeId The shape from a contact event
+ * @return The shape's kind and owner index
+ */
+ShapeRef GetShapeRef(b2ShapeId shapeId) {
+    ShapeRef ref = { shapeId, SHAPE_NONE, 0 };
+    if (!b2Shape_IsValid(shapeId))
+        return ref;
+    uintptr_t handle = (uintptr_t)b2Shape_GetUserData(shapeId);
+    enum ShapeKind kind = (enum ShapeKind)(handle & ((1u << SHAPE_KIND_BITS) - 1));
+    if (kind >= ShapeKindSize)
+        return ref;
+    ref.kind = kind;
+    ref.index = (uint32_t)(handle >> SHAPE_KIND_BITS);
+    return ref;
+}
+
+/**
+ * Route every event of a type between two shape kinds to a handler, in both orders.
+ * @param dispatcher The table to register in
+ * @param type Begin touch, end touch or hit events
+ * @param a The kind of shape passed first to the handler
+ * @param b The kind of shape passed second to the handler
+ * @param handler The function to call
+ */
+void RegisterContactHandler(ContactDispatcher* dispatcher, enum ContactEventType type, enum ShapeKind a, enum ShapeKind b, ContactHandler* handler) {
+    dispatcher->routes[type][a][b] = (ContactRoute){ handler, false };
+    if (a != b)
+        dispatcher->routes[type][b][a] = (ContactRoute){ handler, true };
+}
+
+static void Route(const ContactDispatcher* dispatcher, enum ContactEventType type, b2ShapeId shapeIdA, b2ShapeId shapeIdB, const void* event, void* context) {
+    ShapeRef a = GetShapeRef(shapeIdA);
+    ShapeRef b = GetShapeRef(shapeIdB);
+    const ContactRoute* route = &dispatcher->routes[type][a.kind][b.kind];
+    if (route->handler == nullptr)
+        return;
+    if (route->swap)
+        route->handler(b, a, event, context);
+    else
+        route->handler(a, b, event, context);
+}
+
+/**
+ * Hand every contact event of a step to the handler registered for its pair of shape kinds.
+ * Each event costs two user data lookups and a table lookup, regardless of how many shapes exist.
+ * @param dispatcher The routing table
+ * @param events The world's contact events for the step
+ * @param context Passed through to the handlers
+ */
+void DispatchContactEvents(const ContactDispatcher* dispatcher, b2ContactEvents events, void* context) {
+    for (int i = 0; i < events.hitCount; ++i) {
+        const b2ContactHitEvent* event = events.hitEvents + i;
+        Route(dispatcher, CONTACT_HIT, event->shapeIdA, event->shapeIdB, event, context);
+    }
+    for (int i = 0; i < events.beginCount; ++i) {
+        const b2ContactBeginTouchEvent* event = events.beginEvents + i;
+        Route(dispatcher, CONTACT_BEGIN, event->shapeIdA, event->shapeIdB, event, context);
+    }
+    for (int i = 0; i < events.endCount; ++i) {
+        const b2ContactEndTouchEvent* event = events.endEvents + i;
+        Route(dispatcher, CONTACT_END, event->shapeIdA, event->shapeIdB, event, context);
+    }
+}
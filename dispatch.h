@@ -0,0 +1,62 @@
+//
+// Created by frick on 2025-07-16.
+//
+
+#ifndef DISPATCH_H
+#define DISPATCH_H
+#include <box2d/types.h>
+#include <stdint.h>
+
+/**
+ * What a shape belongs to. Every shape carries its kind, plus the index of its owner
+ * (e.g. which target in the level), packed into its box2d user data.
+ */
+enum ShapeKind {
+    SHAPE_NONE,
+    SHAPE_BALL,
+    SHAPE_PADDLE,
+    SHAPE_TARGET,
+    SHAPE_SOLID,
+    SHAPE_LIMIT,
+    SHAPE_DEATH,
+    SHAPE_BOX,
+    ShapeKindSize
+};
+
+enum ContactEventType {
+    CONTACT_BEGIN,
+    CONTACT_END,
+    CONTACT_HIT,
+    ContactEventTypeSize
+};
+
+typedef struct ShapeRef {
+    b2ShapeId shapeId;
+    enum ShapeKind kind;
+    uint32_t index;
+} ShapeRef;
+
+/**
+ * Handles one contact event between two kinds of shapes.
+ * The shapes are passed in the order the handler was registered with,
+ * whichever order box2d reported them in.
+ * @param event The b2ContactBeginTouchEvent, b2ContactEndTouchEvent or b2ContactHitEvent
+ */
+typedef void ContactHandler(ShapeRef a, ShapeRef b, const void* event, void* context);
+
+typedef struct ContactRoute {
+    ContactHandler* handler;
+    bool swap;
+} ContactRoute;
+
+typedef struct ContactDispatcher {
+    ContactRoute routes[ContactEventTypeSize][ShapeKindSize][ShapeKindSize];
+} ContactDispatcher;
+
+void* MakeShapeHandle(enum ShapeKind kind, uint32_t index);
+ShapeRef GetShapeRef(b2ShapeId shapeId);
+
+void RegisterContactHandler(ContactDispatcher* dispatcher, enum ContactEventType type, enum ShapeKind a, enum ShapeKind b, ContactHandler* handler);
+void DispatchContactEvents(const ContactDispatcher* dispatcher, b2ContactEvents events, void* context);
+
+#endif //DISPATCH_H
@@ -7,160 +7,14 @@
 #include "box2d/box2d.h"
 #include "entities.h"
 #include "assets.h"
+#include "dispatch.h"
+#include "interpolation.h"
+#include "sprites.h"
 #include <sys/types.h>
 
 extern Texture TextureLibrary[TextureEnumSize];
 extern Sound SoundLibrary[SoundEnumSize];
 
-/*  #########################
- *         BALL ENTITY
- *  CONSTRUCTOR AND FUNCTIONS
- *  #########################
-*/
-
-Ball CreateBall(b2Vec2 pos, float radius, Texture* texture, Color color, b2WorldId worldId) {
-    b2Circle circle = {b2Vec2_zero, radius};
-
-    b2BodyDef ballBodyDef = b2DefaultBodyDef();
-    ballBodyDef.type = b2_dynamicBody;
-    ballBodyDef.position = pos;
-    ballBodyDef.isBullet = true;
-
-    b2BodyId bodyId = b2CreateBody(worldId, &ballBodyDef);
-    b2ShapeDef ballShapeDef = b2DefaultShapeDef();
-    ballShapeDef.enableContactEvents = true;
-    ballShapeDef.enableHitEvents = true;
-    ballShapeDef.filter.categoryBits = BALL;
-    ballShapeDef.filter.maskBits = PADDLE | GROUND | BOX | TARGET;
-
-    b2ShapeId shapeId = b2CreateCircleShape(bodyId, &ballShapeDef, &circle);
-    b2Shape_SetRestitution(shapeId, 0.95f);
-    b2ShapeProxy ballProxy = b2MakeProxy(&circle.center, 1, radius);
-
-    Ball ball = {
-        circle,
-        bodyId,
-        ballBodyDef,
-        shapeId,
-        pos,
-        radius,
-        color,
-        ballProxy,
-        texture,
-{[0 ... (BALL_TRACERS - 1)] = pos}
-    };
-
-    return ball;
-}
-
-float BallRayResultFcn(b2ShapeId shapeId, b2Vec2 point, b2Vec2 normal, float fraction, void* context ) {
-    BallRayCastContext* myContext = context;
-    myContext->shapeId = shapeId;
-    myContext->point = point;
-    myContext->normal = normal;
-    myContext->fraction = fraction;
-    if (shapeId.index1 == myContext->targetShapeId.index1) {
-        return fraction;
-    }
-    return -1;
-}
-
-void CheckBallPaddleCollision(Ball* ball, Paddle* paddle, BallRayCastContext* context) {
-    if(context->shapeId.index1 != paddle->shapeId.index1)
-        return;
-
-    b2Sweep sweepA, sweepB;
-    sweepA.c1 = b2Body_GetPosition(ball->bodyId);
-    sweepA.q1 = b2NormalizeRot(b2Body_GetRotation(ball->bodyId));
-    sweepA.c2 = b2MulAdd(b2Body_GetPosition(ball->bodyId), GetFrameTime(), b2Body_GetLinearVelocity(ball->bodyId)); // extrapolated pos
-    b2Rot preRot = b2Body_GetRotation(ball->bodyId);
-    b2Rot rotDelta = b2MakeRot(GetFrameTime() * b2Body_GetAngularVelocity(ball->bodyId));
-    b2Rot finalRot = b2NormalizeRot((b2Rot){preRot.c + rotDelta.c, preRot.s + rotDelta.s});
-    sweepA.q2 = finalRot;
-    sweepA.localCenter = b2Body_GetLocalCenterOfMass(ball->bodyId);
-
-    sweepB.c1 = b2Body_GetPosition(paddle->bodyId);
-    sweepB.q1 = b2NormalizeRot(b2Body_GetRotation(paddle->bodyId));
-    sweepB.c2 = b2MulAdd(b2Body_GetPosition(paddle->bodyId), GetFrameTime(), b2Body_GetLinearVelocity(paddle->bodyId)); // extrapolated pos
-    b2Rot padPreRot = b2Body_GetRotation(paddle->bodyId);
-    b2Rot padRotDelta = b2MakeRot(GetFrameTime() * b2Body_GetAngularVelocity(paddle->bodyId));
-    b2Rot padFinalRot = b2NormalizeRot((b2Rot){padPreRot.c + padRotDelta.c, padPreRot.s + padRotDelta.s});
-    sweepB.q2 = padFinalRot;
-    sweepB.localCenter = b2Body_GetLocalCenterOfMass(paddle->bodyId);
-
-    b2TOIInput input = { 0 };
-    input.proxyA = ball->proxy;
-    input.proxyB = paddle->proxy;
-    input.sweepA = sweepA;
-    input.sweepB = sweepB;
-    input.maxFraction = 1.0f;
-
-    b2TOIOutput output = b2TimeOfImpact(&input);
-    if (
-        (output.state == b2_toiStateHit || 
-         output.state == b2_toiStateOverlapped)&&
-        output.fraction < 1.0f && output.fraction > 0 && b2Body_GetLinearVelocity(ball->bodyId).y > 0.0f
-        ) {
-        b2Vec2 ballPos = b2Body_GetPosition(ball->bodyId);
-        b2Rot ballRot = b2Body_GetRotation(ball->bodyId);
-        b2Vec2 paddlePos = b2Body_GetPosition(paddle->bodyId);
-        b2Vec2 adjustment = b2MulSV(ball->radius, context->normal);
-        b2Vec2 adjPos = b2Add(context->point, adjustment);
-        b2Body_SetTransform(ball->bodyId, adjPos, ballRot);
-    }
-}
-
-void DrawBall(Ball* ball) {
-
-    if (ball->circle.radius != ball->texture->width) {
-        ball->texture->width = ball->circle.radius*2;
-        ball->texture->height = ball->circle.radius*2;
-    }
-    // Draw the ball
-    b2Vec2 ballPos = b2Body_GetPosition(ball->bodyId);
-    Color c = ball->color;
-    c.a = 0;
-    c.b = (c.b / BALL_TRACERS);
-    uint8_t blueDelta = c.b;
-    uint8_t alphaDelta = 255 / (BALL_TRACERS);
-    // #############
-    // Ball tracer logic
-    // #############
-    for (int k = BALL_TRACERS - 1; k > 0; k--){
-        b2Vec2 ballHist = ball->ballHistory[k];
-        float histRad = ball->circle.radius * (1.0f / BALL_TRACERS) * ((float)BALL_TRACERS - (float)k);
-        DrawCircle((int)ballHist.x, (int)ballHist.y, histRad, c);
-        c.b += blueDelta;
-        c.a += (alphaDelta);
-        ball->ballHistory[k] = ball->ballHistory[k-1];
-    }
-    ball->ballHistory[0] = ballPos;
-
-    // Actual ball drawing
-    // Drawing colored ball
-    DrawCircle(ballPos.x, ballPos.y, ball->circle.radius, c);
-    DrawCircleLines(ballPos.x, ballPos.y, ball->circle.radius, WHITE);
-
-    // Drawing Texture
-    b2Rot rotation = b2Body_GetRotation(ball->bodyId);
-    float radians = b2Rot_GetAngle(rotation);
-    b2Vec2 world = b2Body_GetWorldCenterOfMass(ball->bodyId);
-    // Raylib rotates textures around the positional point it is given, meaning the top-left corner is the anchor.
-    // Therefore, we need to compensate by drawing a vector from the ball's center to its "top-left" "corner",
-    // rotating it by the rotation of the b2Body, and adding it to the position of the ball's center to
-    // get the appropriate coordinates for Raylib to draw.
-    b2Vec2 adj = b2RotateVector(rotation, (b2Vec2){-ball->radius, -ball->radius});
-    DrawTextureEx(*(ball->texture), (Vector2){world.x + adj.x, world.y + adj.y}, RAD2DEG * radians, 1.0f, WHITE);
-}
-
-void ResetBall(Ball* ball) {
-    b2Body_SetLinearVelocity(ball->bodyId, b2Vec2_zero);
-    b2Body_SetAngularVelocity(ball->bodyId, 0.0f);
-    b2Body_SetTransform(ball->bodyId,
-        ball->spawn,
-        b2MakeRot(0));
-}
-
 /*  #########################
  *        PADDLE ENTITY
  *  CONSTRUCTOR AND FUNCTIONS
@@ -185,10 +39,11 @@ Paddle CreatePaddle(b2Vec2 spawn, float halfWidth, float halfHeight, Color color
     bodyDef.position = spawn;
     
     bodyDef.isBullet = true;
+    // Follows the cursor, so it must never be put to sleep
+    bodyDef.enableSleep = false;
 
     b2BodyId bodyId = b2CreateBody(worldId, &bodyDef);
     paddle.bodyId = bodyId;
-    paddle.bodyDef = bodyDef;
     //b2MotionLocks motionLocks = { 0 };
     //motionLocks.angularZ = true;
     //b2Body_SetMotionLocks(bodyId, motionLocks);
@@ -198,6 +53,7 @@ Paddle CreatePaddle(b2Vec2 spawn, float halfWidth, float halfHeight, Color color
     shapeDef.enableHitEvents = true;
     shapeDef.filter.categoryBits = PADDLE;
     shapeDef.filter.maskBits = BALLTHRU | BALL | BOX | GROUND | RAY;
+    shapeDef.userData = MakeShapeHandle(SHAPE_PADDLE, 0);
     b2ShapeId shapeId = b2CreatePolygonShape(bodyId, &shapeDef, &polygon);
     paddle.shapeId = shapeId;
 
@@ -207,7 +63,7 @@ Paddle CreatePaddle(b2Vec2 spawn, float halfWidth, float halfHeight, Color color
     return paddle;
 }
 
-void UpdatePaddle(Paddle* paddle, b2Vec2 pos) {
+void UpdatePaddle(Paddle* paddle, b2Vec2 pos, float time) {
     b2Transform target = {
         pos,
         //b2Body_GetRotation(paddle->bodyId)
@@ -215,8 +71,7 @@ void UpdatePaddle(Paddle* paddle, b2Vec2 pos) {
     };
     b2Body_SetTargetTransform(paddle->bodyId, target, 0.1f);
     if (paddle->touchingLimit) {
-        float nowTime = GetTime();
-        paddle->timeDelta = nowTime - paddle->lastTouchTime;
+        paddle->timeDelta = time - paddle->lastTouchTime;
     }
 }
 
@@ -224,8 +79,9 @@ void DrawPaddle(Paddle* paddle) {
     if (!b2Body_IsEnabled(paddle->bodyId))
         return;
 
-    b2Vec2 pos = b2Body_GetPosition(paddle->bodyId);
-    b2Rot rotation = b2Body_GetRotation(paddle->bodyId);
+    b2Transform transform = GetRenderTransform(paddle->bodyId);
+    b2Vec2 pos = transform.p;
+    b2Rot rotation = transform.q;
     float radians = b2Rot_GetAngle(rotation);
 
     b2Vec2 toLeft = {-paddle->extent.x, -paddle->extent.y};
@@ -235,20 +91,20 @@ void DrawPaddle(Paddle* paddle) {
     b2Vec2 toRight = {paddle->extent.x / 3.0f, -paddle->extent.y};
     b2Vec2 rightAdj = b2RotateVector(rotation, toRight);
 
-    DrawTextureEx(
-        TextureLibrary[t_paddle_left], 
+    DrawSprite(
+        t_paddle_left, 
         (Vector2){pos.x + leftAdj.x, pos.y + leftAdj.y}, RAD2DEG * radians, 
         1.0f, 
         WHITE);
 
-    DrawTextureEx(
-        TextureLibrary[t_paddle_mid],
+    DrawSprite(
+        t_paddle_mid,
         (Vector2){pos.x + midAdj.x, pos.y + midAdj.y}, RAD2DEG * radians, 
         1.0f, 
         WHITE);
 
-    DrawTextureEx(
-        TextureLibrary[t_paddle_right], 
+    DrawSprite(
+        t_paddle_right, 
         (Vector2){pos.x + rightAdj.x, pos.y + rightAdj.y}, RAD2DEG * radians, 
         1.0f, 
         WHITE);
@@ -260,7 +116,16 @@ void DrawPaddle(Paddle* paddle) {
  *  #########################
 */
 
-Target CreateTarget(b2Vec2 spawn, float scale, Color color, b2WorldId worldId) {
+/**
+ * Creates a target that wakes up when hit by the ball, and breaks when hit again.
+ * @param spawn The center of the target
+ * @param scale The size of the target relative to its texture
+ * @param color Unused, kept for symmetry with the other constructors
+ * @param index The target's slot in its level, which contact events report back
+ * @param worldId The world to spawn the target in
+ * @return A static Target
+ */
+Target CreateTarget(b2Vec2 spawn, float scale, Color color, int index, b2WorldId worldId) {
     b2Vec2 extent = {TextureLibrary[t_target_rest].width * 0.5f * scale, TextureLibrary[t_target_rest].height * 0.5f * scale};
     b2Polygon polygon = b2MakeBox(extent.x, extent.y);
 
@@ -277,6 +142,7 @@ Target CreateTarget(b2Vec2 spawn, float scale, Color color, b2WorldId worldId) {
     targetShapeDef.filter.categoryBits = TARGET;
     targetShapeDef.filter.maskBits = PADDLE | GROUND | BOX | BALL | BALLTHRU | TARGET;
     targetShapeDef.density = 0.1f;
+    targetShapeDef.userData = MakeShapeHandle(SHAPE_TARGET, index);
 
     b2ShapeId shapeId = b2CreatePolygonShape(targetBodyId, &targetShapeDef, &polygon);
     b2Shape_SetRestitution(shapeId, 0.9);
@@ -284,7 +150,6 @@ Target CreateTarget(b2Vec2 spawn, float scale, Color color, b2WorldId worldId) {
 
     Target target = {
         targetBodyId,
-        targetBodyDef,
         shapeId,
         extent,
         proxy,
@@ -295,6 +160,21 @@ Target CreateTarget(b2Vec2 spawn, float scale, Color color, b2WorldId worldId) {
     return target;
 }
 
+/**
+ * Put a target back at rest, static and unbroken, reusing its body and shape.
+ * @param spawn The new center of the target
+ */
+void ResetTarget(Target* target, b2Vec2 spawn) {
+    b2BodyId bodyId = target->bodyId;
+    b2Body_SetType(bodyId, b2_staticBody);
+    b2Body_SetTransform(bodyId, spawn, b2Rot_identity);
+    b2Body_SetLinearVelocity(bodyId, b2Vec2_zero);
+    b2Body_SetAngularVelocity(bodyId, 0.0f);
+    b2Body_Enable(bodyId);
+    InterpolationSnap(bodyId);
+    target->state = 0;
+}
+
 void UpdateTarget(Target* target) {
 
 }
@@ -305,10 +185,11 @@ void DrawTarget(Target* target) {
         return;
 
     // Get position and rotation
-    b2Vec2 p = b2Body_GetWorldPoint(
-        target->bodyId, 
+    b2Transform transform = GetRenderTransform(target->bodyId);
+    b2Vec2 p = b2TransformPoint(
+        transform, 
         (b2Vec2) { -target->extent.x, -target->extent.y });
-    b2Rot rotation = b2Body_GetRotation(target->bodyId);
+    b2Rot rotation = transform.q;
     float radians = b2Rot_GetAngle(rotation);
     //b2Vec2 adj = b2RotateVector(
     //    rotation, 
@@ -316,8 +197,8 @@ void DrawTarget(Target* target) {
     //Vector2 ps = {p.x + adj.x, p.y + adj.y};
     // Convert to RayLib Vector2
     Vector2 ps = {p.x, p.y};
-    DrawTextureEx(
-        TextureLibrary[t_target_rest + target->state], 
+    DrawSprite(
+        t_target_rest + target->state, 
         ps, 
         RAD2DEG * radians, 
         target->scale, 
@@ -337,7 +218,7 @@ void DrawTarget(Target* target) {
  * @param worldId The world to spawn the box in
  * @return An Entity in the form of a static block
  */
-Entity CreateSolid(b2Vec2 pos, b2Vec2 extent, Texture* texture, Color color, b2WorldId worldId) {
+Entity CreateSolid(b2Vec2 pos, b2Vec2 extent, int sprite, Color color, b2WorldId worldId) {
     b2Polygon groundPolygon = b2MakeBox(extent.x, extent.y);
     Entity entity = { 0 };
     entity.color = color;
@@ -346,24 +227,19 @@ Entity CreateSolid(b2Vec2 pos, b2Vec2 extent, Texture* texture, Color color, b2W
     b2BodyDef bodyDef = b2DefaultBodyDef();
     bodyDef.position = pos;
     bodyDef.type = b2_staticBody;
-    entity.bodyDef = bodyDef;
     entity.bodyId = b2CreateBody(worldId, &bodyDef);
 
-    if (texture != nullptr) {
-        entity.texture = *texture;
-    }
-    else {
-        entity.texture.id = -1;
-    }
+    entity.sprite = sprite;
     b2ShapeDef shapeDef = b2DefaultShapeDef();
     shapeDef.filter.categoryBits = GROUND;
+    shapeDef.userData = MakeShapeHandle(SHAPE_SOLID, 0);
     b2ShapeId shapeId = b2CreatePolygonShape(entity.bodyId, &shapeDef, &groundPolygon);
     b2Shape_SetFriction(shapeId, 0.0f);
     entity.shapeId = shapeId;
     return entity;
 }
 
-Entity CreateDeathZone(b2Vec2 pos, b2Vec2 extent, Texture* texture, Color color, b2WorldId worldId) {
+Entity CreateDeathZone(b2Vec2 pos, b2Vec2 extent, int sprite, Color color, b2WorldId worldId) {
     b2Polygon deathPolygon = b2MakeBox(extent.x, extent.y);
     Entity entity = { 0 };
     entity.color = color;
@@ -372,34 +248,33 @@ Entity CreateDeathZone(b2Vec2 pos, b2Vec2 extent, Texture* texture, Color color,
     b2BodyDef bodyDef = b2DefaultBodyDef();
     bodyDef.position = pos;
     bodyDef.type = b2_staticBody;
-    entity.bodyDef = bodyDef;
     entity.bodyId = b2CreateBody(worldId, &bodyDef);
 
-    if (texture != nullptr) {
-        entity.texture = *texture;
-    }
-    else {
-        entity.texture.id = -1;
-    }
+    entity.sprite = sprite;
     b2ShapeDef shapeDef = b2DefaultShapeDef();
     shapeDef.filter.categoryBits = DEATH;
     shapeDef.filter.maskBits = BALL;
+    shapeDef.userData = MakeShapeHandle(SHAPE_DEATH, 0);
     b2ShapeId shapeId = b2CreatePolygonShape(entity.bodyId, &shapeDef, &deathPolygon);
     entity.shapeId = shapeId;
     return entity;
 }
 
-Entity CreatePhysicsBox(b2Vec2 pos, b2Vec2 extent, Texture* texture, b2WorldId worldId) {
+/**
+ * @param index The box's slot among the world's boxes, which queries and contact events report back
+ */
+Entity CreatePhysicsBox(b2Vec2 pos, b2Vec2 extent, int sprite, int index, b2WorldId worldId) {
     b2Polygon boxPolygon = b2MakeBox(extent.x, extent.y);
     Entity box = { 0 };
     b2BodyDef bodyDef = b2DefaultBodyDef();
     bodyDef.type = b2_dynamicBody;
     bodyDef.position = pos;
     box.bodyId = b2CreateBody(worldId, &bodyDef);
-    box.texture = *texture;
+    box.sprite = sprite;
     box.extent = extent;
     b2ShapeDef shapeDef = b2DefaultShapeDef();
     shapeDef.filter.categoryBits = BOX;
+    shapeDef.userData = MakeShapeHandle(SHAPE_BOX, (uint32_t)index);
     box.shapeId = b2CreatePolygonShape(box.bodyId, &shapeDef, &boxPolygon);
     return box;
 }
@@ -409,18 +284,21 @@ void DrawEntity(const Entity* entity)
     if (!b2Body_IsEnabled(entity->bodyId))
         return;
     // The boxes were created centered on the bodies, but raylib draws textures starting at the top left corner.
-    // b2Body_GetWorldPoint gets the top left corner of the box accounting for rotation.
-    b2Vec2 p = b2Body_GetWorldPoint(entity->bodyId, (b2Vec2) { -entity->extent.x, -entity->extent.y });
-    b2Rot rotation = b2Body_GetRotation(entity->bodyId);
+    // b2TransformPoint gets the top left corner of the box accounting for rotation.
+    b2Transform transform = GetRenderTransform(entity->bodyId);
+    b2Vec2 p = b2TransformPoint(transform, (b2Vec2) { -entity->extent.x, -entity->extent.y });
+    b2Rot rotation = transform.q;
     float radians = b2Rot_GetAngle(rotation);
 
     Vector2 ps = {p.x, p.y};
-    if (entity->texture.id == -1) {
+    if (entity->sprite == SPRITE_NONE) {
         Rectangle rect = {p.x, p.y, entity->extent.x * 2, entity->extent.y * 2};
         DrawRectanglePro(rect, (Vector2){0, 0}, RAD2DEG * radians, entity->color);
     }
     else {
-        DrawTextureEx(entity->texture, ps, RAD2DEG * radians, 1.0f, WHITE);
+        // Boxes may be smaller than their texture when there are many of them
+        float scale = 2.0f * entity->extent.x / TextureLibrary[entity->sprite].width;
+        DrawSprite(entity->sprite, ps, RAD2DEG * radians, scale, WHITE);
     }
 
 }
\ No newline at end of file
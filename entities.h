@@ -7,7 +7,7 @@
 
 #include "box2d/types.h"
 #include "raylib.h"
-constexpr int BALL_TRACERS = 35;
+#include "sprites.h"
 
 enum CATS {
     TARGET = 0x0001,
@@ -22,49 +22,27 @@ enum CATS {
 
 typedef struct Entity {
     b2BodyId bodyId;
-    b2BodyDef bodyDef;
     b2ShapeId shapeId;
     b2Vec2 extent;
-    Texture texture;
+    int sprite;
     Color color;
 } Entity;
 
-Entity CreateSolid(b2Vec2 pos, b2Vec2 extent, Texture* texture, Color color, b2WorldId worldId);
-Entity CreateDeathZone(b2Vec2 pos, b2Vec2 extent, Texture* texture, Color color, b2WorldId worldId);
-Entity CreatePhysicsBox(b2Vec2 pos, b2Vec2 extent, Texture* texture, b2WorldId worldId);
+Entity CreateSolid(b2Vec2 pos, b2Vec2 extent, int sprite, Color color, b2WorldId worldId);
+Entity CreateDeathZone(b2Vec2 pos, b2Vec2 extent, int sprite, Color color, b2WorldId worldId);
+Entity CreatePhysicsBox(b2Vec2 pos, b2Vec2 extent, int sprite, int index, b2WorldId worldId);
 void DrawEntity(const Entity* entity);
 
-typedef struct Ball {
-    b2Circle circle;
-    b2BodyId bodyId;
-    b2BodyDef bodyDef;
-    b2ShapeId shapeId;
-    b2Vec2 spawn;
-    float radius;
-    Color color;
-    b2ShapeProxy proxy;
-    Texture* texture;
-    b2Vec2 ballHistory[BALL_TRACERS];
-} Ball;
-
 typedef struct BallRayCastContext
 {
     b2ShapeId shapeId;
     b2ShapeId targetShapeId;
     b2Vec2 point;
     b2Vec2 normal;
-    float fraction;
 } BallRayCastContext;
 
-b2CastResultFcn BallRayResultFcn;
-
-Ball CreateBall(b2Vec2 pos, float radius, Texture* texture, Color color, b2WorldId worldId);
-void DrawBall(Ball* ball);
-void ResetBall(Ball* ball);
-
 typedef struct Paddle {
     b2BodyId bodyId;
-    b2BodyDef bodyDef;
     b2ShapeId shapeId;
     b2Vec2 extent;
     Texture* textures;
@@ -77,13 +55,11 @@ typedef struct Paddle {
 } Paddle;
 
 Paddle CreatePaddle(b2Vec2 spawn, float halfWidth, float halfHeight, Color color, b2WorldId worldId);
-void CheckBallPaddleCollision(Ball* ball, Paddle* paddle, BallRayCastContext* context);
-void UpdatePaddle(Paddle* paddle, b2Vec2 pos);
+void UpdatePaddle(Paddle* paddle, b2Vec2 pos, float time);
 void DrawPaddle(Paddle* paddle);
 
 typedef struct Target {
     b2BodyId bodyId;
-    b2BodyDef bodyDef;
     b2ShapeId shapeId;
     b2Vec2 extent;
     b2ShapeProxy proxy;
@@ -91,7 +67,8 @@ typedef struct Target {
     int state;
 } Target;
 
-Target CreateTarget(b2Vec2 spawn, float scale, Color color, b2WorldId worldId);
+Target CreateTarget(b2Vec2 spawn, float scale, Color color, int index, b2WorldId worldId);
+void ResetTarget(Target* target, b2Vec2 spawn);
 void UpdateTarget(Target* target);
 void DrawTarget(Target* target);
 
@@ -0,0 +1,784 @@
+//
+// Created by frick on 2025-07-27.
+//
+
+#include "game.h"
+#include "box2d/box2d.h"
+#include "box2d/collision.h"
+#include "assets.h"
+#include "audio.h"
+#include "interpolation.h"
+#include "jobs.h"
+#include "logger.h"
+#include "profiler.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(PLATFORM_WEB) || defined(__EMSCRIPTEN__)
+    #define GAME_NO_THREAD
+#else
+    #include <pthread.h>
+#endif
+
+extern Texture TextureLibrary[TextureEnumSize];
+
+#ifndef GAME_NO_THREAD
+// box2d hands out world ids from a table without a lock, so worlds are created and destroyed one at a time
+static pthread_mutex_t worldTableLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static b2WorldId CreateWorldLocked(const b2WorldDef* worldDef) {
+#ifndef GAME_NO_THREAD
+    pthread_mutex_lock(&worldTableLock);
+#endif
+    b2WorldId worldId = b2CreateWorld(worldDef);
+#ifndef GAME_NO_THREAD
+    pthread_mutex_unlock(&worldTableLock);
+#endif
+    return worldId;
+}
+
+static void DestroyWorldLocked(b2WorldId worldId) {
+#ifndef GAME_NO_THREAD
+    pthread_mutex_lock(&worldTableLock);
+#endif
+    b2DestroyWorld(worldId);
+#ifndef GAME_NO_THREAD
+    pthread_mutex_unlock(&worldTableLock);
+#endif
+}
+
+static float InvLerp(float a, float b, float t) {
+    return (t - a) / (b - a);
+}
+
+// ##############
+// Contact events
+// ##############
+
+static void OnBallHitTarget(ShapeRef ball, ShapeRef targetShape, const void* event, void* context) {
+    GameContext* game = context;
+    Target* target = game->level.targets + targetShape.index;
+    GAME_LOG(SEVERITY_DEBUG, LOGCAT_CONTACTS, "Hit: ball -> target %u (state %d)", targetShape.index, target->state);
+    if (target->state == 0) {
+        target->state = 1;
+        //b2MassData massData = b2Body_GetMassData(target->bodyId);
+        //massData.mass = 5.0f;
+        //b2Body_SetMassData(target->bodyId, massData);
+        b2Body_SetType(target->bodyId, b2_dynamicBody);
+        b2Vec2 ballVel = b2Body_GetLinearVelocity(b2Shape_GetBody(ball.shapeId));
+        ballVel.x *= -1;
+        ballVel.y *= -1;
+        b2Body_SetLinearVelocity(target->bodyId, ballVel);
+        game->gameState.score += 20;
+        game->geometryVersion++;
+    }
+    else if (target->state == 1){
+        // The body is kept for the next restart
+        BreakTarget(&game->level, (int)targetShape.index);
+        game->gameState.score += 30;
+        game->geometryVersion++;
+    }
+    int r = RandomInt(&game->random, 4);
+    if (game->config.presented)
+        QueueSound(EFFECT_TARGET, r, 0.75f);
+}
+
+static void OnBallHitPaddle(ShapeRef ball, ShapeRef paddleShape, const void* event, void* context) {
+    GameContext* game = context;
+    game->paddleHit = true;
+    GAME_LOG(SEVERITY_DEBUG, LOGCAT_CONTACTS, "Hit: ball -> paddle");
+    // Audio level determination
+    b2BodyId ballBody = b2Shape_GetBody(ball.shapeId);
+    b2Vec2 vel = b2Body_GetLinearVelocity(ballBody);
+    float volMod = b2Length(vel);
+    float vol = sqrtf(InvLerp(0, 10000, volMod));
+    int r = RandomInt(&game->random, 3);
+    if (game->config.presented)
+        QueueSound(EFFECT_PADDLE, r, vol);
+}
+
+static void OnPaddleTouchLimit(ShapeRef paddleShape, ShapeRef limitShape, const void* event, void* context) {
+    GameContext* game = context;
+    game->paddle.touchingLimit = true;
+    game->paddle.lastTouchTime = game->simulationTime;
+}
+
+static void OnPaddleLeaveLimit(ShapeRef paddleShape, ShapeRef limitShape, const void* event, void* context) {
+    GameContext* game = context;
+    game->paddle.touchingLimit = false;
+}
+
+// ##############
+// Boxes
+// ##############
+
+// Queries for boxes near the cursor see nothing else
+static const b2QueryFilter BOX_QUERY_FILTER = { .categoryBits = RAY, .maskBits = BOX };
+// Radius of the right-click force field, and how fast it pushes per unit of distance
+static const float FORCE_FIELD_REACH = 256.0f;
+static const float FORCE_FIELD_STRENGTH = 10.0f;
+// How far past the edges of the screen a box may fly before it is despawned
+static const float DEBRIS_MARGIN = 512.0f;
+
+/**
+ * Create the world's boxes. The default few are stacked in the middle of the screen as they always were;
+ * more are laid out in a grid over the arena, shrunk as needed to fit.
+ * @param arena The inside of the arena, in world units
+ * @return False if there was no memory for them
+ */
+static bool CreateBoxes(GameContext* game, Rectangle arena) {
+    int count = game->config.boxCount;
+    if (count > MAX_BOXES)
+        count = MAX_BOXES;
+    if (count <= 0)
+        return true;
+
+    size_t size = DebrisPoolSize(count) + MEMARENA_SIZE(b2Vec2, count)
+        + MEMARENA_SIZE(int, count) + 4 * MEMARENA_SIZE(float, count) + MEMARENA_SIZE(uint8_t, count);
+    if (!MemArenaInit(&game->boxArena, size))
+        return false;
+    MemArena* boxArena = &game->boxArena;
+    InitDebrisPool(&game->debris, boxArena, count, game->worldId);
+    game->boxSpawns = MEMARENA_ALLOC(boxArena, b2Vec2, count);
+    BoxQuery* query = &game->boxQuery;
+    query->boxes = MEMARENA_ALLOC(boxArena, int, count);
+    query->x = MEMARENA_ALLOC(boxArena, float, count);
+    query->y = MEMARENA_ALLOC(boxArena, float, count);
+    query->vx = MEMARENA_ALLOC(boxArena, float, count);
+    query->vy = MEMARENA_ALLOC(boxArena, float, count);
+    query->inside = MEMARENA_ALLOC(boxArena, uint8_t, count);
+    query->capacity = count;
+    game->boxCount = count;
+
+    float width = (float)game->config.width;
+    float height = (float)game->config.height;
+    b2Vec2 boxExtent = { 0.5f * TextureLibrary[t_box].width, 0.5f * TextureLibrary[t_box].height };
+    // Cells of the grid, sized so the boxes take up at most half the arena
+    float cell = sqrtf(arena.width * arena.height * 0.5f / count);
+    int columns = (int)(arena.width / cell);
+    if (columns < 1)
+        columns = 1;
+    if (count > BOX_COUNT && cell < 2.5f * boxExtent.x)
+        boxExtent = b2MulSV(cell / (2.5f * boxExtent.x), boxExtent);
+    game->boxExtent = boxExtent;
+
+    for (int i = 0; i < count; ++i)
+    {
+        b2Vec2 position;
+        if (count <= BOX_COUNT) {
+            position.y = height - boxExtent.y - 100.0f - (2.5f * i + 2.0f) * boxExtent.y - 20.0f;
+            position.x = 0.5f * width + (3.0f * i - 3.0f) * boxExtent.x;
+        }
+        else {
+            position.x = arena.x + cell * (i % columns + 0.5f);
+            position.y = arena.y + cell * (i / columns + 0.5f);
+        }
+        game->boxSpawns[i] = position;
+        SpawnDebris(&game->debris, position, boxExtent, t_box);
+    }
+    return true;
+}
+
+static bool CollectBoxFcn(b2ShapeId shapeId, void* context) {
+    BoxQuery* query = context;
+    ShapeRef shape = GetShapeRef(shapeId);
+    if (shape.kind == SHAPE_BOX && query->count < query->capacity)
+        query->boxes[query->count++] = (int)shape.index;
+    return true;
+}
+
+/**
+ * Find the boxes whose bounds overlap an area, through the broadphase.
+ * @return How many were found, listed in game->boxQuery.boxes
+ */
+static int QueryBoxes(GameContext* game, b2AABB bounds) {
+    BoxQuery* query = &game->boxQuery;
+    query->count = 0;
+    if (game->boxCount > 0)
+        b2World_OverlapAABB(game->worldId, bounds, BOX_QUERY_FILTER, CollectBoxFcn, query);
+    return query->count;
+}
+
+/**
+ * @return The box under a point, the first one created if several overlap there, or null
+ */
+static Entity* PickBox(GameContext* game, b2Vec2 point) {
+    int count = QueryBoxes(game, (b2AABB){point, point});
+    int picked = -1;
+    for (int i = 0; i < count; i++) {
+        int box = game->boxQuery.boxes[i];
+        if ((picked < 0 || box < picked) && b2Shape_TestPoint(game->debris.entities[box].shapeId, point))
+            picked = box;
+    }
+    return picked >= 0 ? game->debris.entities + picked : nullptr;
+}
+
+/**
+ * The force field over every candidate at once. A box within reach of the center is pushed away from it,
+ * faster the further out it is: the field's direction scaled by its distance is just the offset, scaled.
+ * Branch-free over plain arrays, so the compiler turns it into SIMD.
+ */
+static void ForceFieldKernel(int count, const float* restrict x, const float* restrict y, b2Vec2 center,
+    float reach, float strength, float* restrict vx, float* restrict vy, uint8_t* restrict inside) {
+    float reachSquared = reach * reach;
+    for (int i = 0; i < count; i++) {
+        float dx = x[i] - center.x;
+        float dy = y[i] - center.y;
+        vx[i] = strength * dx;
+        vy[i] = strength * dy;
+        inside[i] = dx * dx + dy * dy <= reachSquared;
+    }
+}
+
+/**
+ * Push the boxes near a point away from it. Only the boxes the broadphase finds within reach are looked at.
+ * @return How many boxes were pushed
+ */
+static int ApplyForceField(GameContext* game, b2Vec2 center) {
+    b2Vec2 reach = { FORCE_FIELD_REACH, FORCE_FIELD_REACH };
+    int count = QueryBoxes(game, (b2AABB){ b2Sub(center, reach), b2Add(center, reach) });
+    BoxQuery* query = &game->boxQuery;
+    for (int i = 0; i < count; i++) {
+        b2Vec2 position = b2Body_GetWorldCenterOfMass(game->debris.entities[query->boxes[i]].bodyId);
+        query->x[i] = position.x;
+        query->y[i] = position.y;
+    }
+    ForceFieldKernel(count, query->x, query->y, center, FORCE_FIELD_REACH, FORCE_FIELD_STRENGTH, query->vx, query->vy, query->inside);
+
+    int pushed = 0;
+    for (int i = 0; i < count; i++) {
+        if (!query->inside[i])
+            continue;
+        const Entity* entity = game->debris.entities + query->boxes[i];
+        b2Vec2 velocity = { query->vx[i], query->vy[i] };
+        b2Body_SetLinearVelocity(entity->bodyId, velocity);
+        // Only a few are kept for the debug overlay
+        if (pushed < BOX_COUNT)
+            game->VectorsToDraw[pushed] = velocity;
+        pushed++;
+        if (b2Shape_TestPoint(entity->shapeId, center))
+            GAME_LOG(SEVERITY_DEBUG, LOGCAT_INPUT, "Force-field on box at (%.2f, %.2f)", query->x[i], query->y[i]);
+    }
+    return pushed;
+}
+
+/**
+ * Record the state before a step into the history ring, in worlds configured to keep one.
+ */
+static void RecordHistory(GameContext* game) {
+    if (!game->config.keepHistory || !TakeSnapshot(game->history + game->historyHead, game))
+        return;
+    game->historyHead = (game->historyHead + 1) % SNAPSHOT_HISTORY;
+    if (game->historyCount < SNAPSHOT_HISTORY)
+        game->historyCount++;
+}
+
+/**
+ * The ball just met the paddle: keep the oldest snapshot in the history as the start of the shot.
+ * It is swapped out rather than copied, and its slot in the ring is the next to be written anyway.
+ */
+static void KeepShotStart(GameContext* game) {
+    if (game->historyCount == 0)
+        return;
+    int oldest = (game->historyHead - game->historyCount + SNAPSHOT_HISTORY) % SNAPSHOT_HISTORY;
+    GameSnapshot swap = game->shotStart;
+    game->shotStart = game->history[oldest];
+    game->history[oldest] = swap;
+    game->historyCount--;
+}
+
+/**
+ * Forget the history and the shot, when the world was reset and they no longer lead up to it.
+ */
+static void ForgetHistory(GameContext* game) {
+    game->historyCount = 0;
+    game->shotStart.taken = false;
+}
+
+/**
+ * Put every box back in play, despawned ones included, and let go of the one held.
+ */
+static void ResetBoxes(GameContext* game) {
+    float width = (float)game->config.width;
+    DespawnAllDebris(&game->debris);
+    game->holdingEntity = false;
+    game->lastHeldEntity = nullptr;
+    for (int i = 0; i < game->boxCount; ++i) {
+        // The default few drop from the top, a grid goes back where it started
+        b2Vec2 position = game->boxSpawns[i];
+        if (game->boxCount <= BOX_COUNT)
+            position = (b2Vec2){
+                128 + (width-64)/BOX_COUNT * (float)(i/(1+i%2)),
+                i%2 * 128
+            };
+        SpawnDebris(&game->debris, position, game->boxExtent, t_box);
+    }
+}
+
+static b2Vec2 PaddleSpawn(const GameConfig* config) {
+    return (b2Vec2){ config->width / 2.0f, config->height * 0.95f };
+}
+
+/**
+ * Serve the starting balls from the level's ball spawn, taking any balls in play out first.
+ */
+static void ServeStartingBalls(GameContext* game) {
+    //TODO: Investigate further why ballspawn is not where it should be
+    Vector2 ballTest = GetWorldToScreen2D(
+        (Vector2){
+            game->level.ballSpawn.x,
+            game->level.ballSpawn.y
+        }, game->camera);
+    game->ballSpawn = (b2Vec2){ballTest.x, ballTest.y};
+    DespawnAllBalls(&game->balls);
+    game->trackedBall = -1;
+    ResetTrajectory(&game->trajectory);
+    game->geometryVersion++;
+    for (int i = 0; i < game->config.startingBalls; i++)
+        SpawnPlayerBall(game, i);
+}
+
+/**
+ * Build a world: the arena, the boxes, the paddle, the level and the starting balls.
+ * Call b2SetLengthUnitsPerMeter(LENGTH_UNITS_PER_METER) once before building the first world.
+ * @param game Overwritten entirely
+ * @param config Copied into the context
+ */
+void InitWorld(GameContext* game, const GameConfig* config) {
+    memset(game, 0, sizeof *game);
+    game->config = *config;
+    float width = (float)config->width;
+    float height = (float)config->height;
+
+    Camera2D* camera = &game->camera;
+    camera->target = (Vector2){ width/2.0f, height/2.0f };
+    camera->offset = (Vector2){ width/2.0f, height/2.0f };
+    camera->rotation = 0.0f;
+    camera->zoom = 0.5f;
+
+    float lengthUnitsPerMeter = LENGTH_UNITS_PER_METER;
+    b2WorldDef worldDef = b2DefaultWorldDef();
+
+    // Realistic gravity is achieved by multiplying gravity by the length unit.
+    worldDef.gravity.y = 9.8f * lengthUnitsPerMeter;
+    // Resting boxes sleep. The balls and the paddle opt out, as they are in play all the time.
+    worldDef.enableSleep = true;
+    worldDef.hitEventThreshold = 2.0f * lengthUnitsPerMeter;
+    if (config->parallelSolver)
+        JobsConfigureWorld(&worldDef);
+    b2WorldId worldId = CreateWorldLocked(&worldDef);
+    game->worldId = worldId;
+    if (config->presented)
+        InterpolationReset(worldId);
+
+    ContactDispatcher* dispatcher = &game->contactDispatcher;
+    RegisterContactHandler(dispatcher, CONTACT_HIT, SHAPE_BALL, SHAPE_TARGET, OnBallHitTarget);
+    RegisterContactHandler(dispatcher, CONTACT_HIT, SHAPE_BALL, SHAPE_PADDLE, OnBallHitPaddle);
+    RegisterContactHandler(dispatcher, CONTACT_BEGIN, SHAPE_PADDLE, SHAPE_LIMIT, OnPaddleTouchLimit);
+    RegisterContactHandler(dispatcher, CONTACT_END, SHAPE_PADDLE, SHAPE_LIMIT, OnPaddleLeaveLimit);
+
+    game->gameState = (GameState){
+        .paused = false,
+        .state = GAME_ACTIVE,
+        .score = 0
+    };
+    SeedRandom(&game->random, config->seed);
+
+    // Top-left and bottom-right vectors
+    Vector2 screenOrigin = GetScreenToWorld2D((Vector2){0, 0}, *camera);
+    Vector2 screenMax = GetScreenToWorld2D((Vector2){width, height}, *camera);
+    game->screenBounds = (Rectangle){screenOrigin.x, screenOrigin.y, screenMax.x - screenOrigin.x, screenMax.y - screenOrigin.y};
+    b2Vec2 margin = { DEBRIS_MARGIN, DEBRIS_MARGIN };
+    game->debrisBounds = (b2AABB){
+        b2Sub((b2Vec2){screenOrigin.x, screenOrigin.y}, margin),
+        b2Add((b2Vec2){screenMax.x, screenMax.y}, margin)
+    };
+
+    b2Vec2 staticsExtent = { 0.5f * TextureLibrary[t_block_idle].width, 0.5f * TextureLibrary[t_block_idle].height };
+
+    // Defining the solid walls
+    b2Vec2 wallExtent = {
+        TextureLibrary[t_wall_left].width * 0.5f,
+        (screenMax.y - screenOrigin.y) * 0.5f
+    };
+    b2Vec2 lPos = {
+        screenOrigin.x + staticsExtent.x,
+        screenOrigin.y + (screenMax.y - screenOrigin.y) * 0.5f
+    };
+    b2Vec2 rPos = {
+        screenMax.x - staticsExtent.x,
+        screenOrigin.y + (screenMax.y - screenOrigin.y) * 0.5f
+    };
+    game->leftWall = CreateSolid(lPos, wallExtent, SPRITE_NONE, PURPLE, worldId);
+    game->rightWall = CreateSolid(rPos, wallExtent, SPRITE_NONE, PURPLE, worldId);
+
+    // Defining the solid ceiling
+    b2Vec2 ceilPos = {
+        screenOrigin.x + ((screenMax.x - screenOrigin.x) / 2),
+        screenOrigin.y + TextureLibrary[t_ceiling_left].height * 0.5f
+    };
+    b2Vec2 ceilExtent = {((screenMax.x - screenOrigin.x) / 2), TextureLibrary[t_ceiling_left].height * 0.5f };
+    game->ceiling = CreateSolid(ceilPos, ceilExtent, SPRITE_NONE, WHITE, worldId);
+
+    // Where the paddle's movement limit goes, which bounds the arena from below
+    b2Vec2 limPos = {width / 2.0f, height * 0.85f + TextureLibrary[t_limit].height / 2.0f};
+    b2Vec2 limExtent = {width, 16};
+
+    // Establish the inner bounds of the arena
+    // TODO: Clean this up (move to arena.c?)
+    float innerWidth = (rPos.x - game->rightWall.extent.x) - (lPos.x + game->leftWall.extent.x);
+    float innerHeight =  (limPos.y - limExtent.y) - (ceilPos.y + ceilExtent.y);
+    Vector2 innerOrigin = {(lPos.x + game->leftWall.extent.x), (ceilPos.y + ceilExtent.y)};
+
+    if (!CreateBoxes(game, (Rectangle){innerOrigin.x, innerOrigin.y, innerWidth, innerHeight}))
+        GAME_LOG(SEVERITY_ERROR, LOGCAT_GENERAL, "Could not allocate %d boxes", config->boxCount);
+
+    // Create the paddle
+    game->paddle = CreatePaddle(
+        PaddleSpawn(config),
+        1.2f * lengthUnitsPerMeter,
+        0.4f * lengthUnitsPerMeter,
+        BLUE,
+        worldId
+        );
+
+    // Create the paddle's movement limit
+    // TODO: Make special function for this
+    game->limit = CreateSolid(
+        limPos,
+        limExtent,
+        SPRITE_NONE, WHITE, worldId
+        );
+
+    b2Filter filt = { 0 };
+    filt.categoryBits = BALLTHRU;
+    filt.maskBits = PADDLE | TARGET;
+    b2Shape_SetFilter(game->limit.shapeId, filt);
+    b2Shape_SetUserData(game->limit.shapeId, MakeShapeHandle(SHAPE_LIMIT, 0));
+
+    // Establish the death zone
+    // TODO: Allow levels to define their specific death zone
+    float dzHeight = 100;
+    b2Vec2 dzExtent = {innerWidth / 2, dzHeight};
+    b2Vec2 dzPos = {innerOrigin.x + dzExtent.x, screenMax.y - dzExtent.y};
+    game->deathZone = CreateDeathZone(dzPos, dzExtent, SPRITE_NONE, WHITE, worldId);
+
+    game->mousePosition = (Vector2){ width / 2.0f, height / 2.0f };
+
+    Vector2 center = {
+        screenMax.x - (screenMax.x - screenOrigin.x) / 2,
+        screenMax.y - (screenMax.y - screenOrigin.y) / 2
+    };
+    Rectangle pauseMenuBounds = {
+        center.x - innerWidth  / 8,
+        center.y - innerHeight  / 2,
+        innerWidth / 4,
+        innerHeight
+    };
+    // Every world has the menu, so a click on it replays the same headless; only presented worlds draw it
+    game->pauseMenu = CreatePauseMenu(
+        &game->gameState,
+        pauseMenuBounds);
+    //printf("Available Width / Height: %.3f / %.3f", innerWidth, innerHeight);
+    if (!LoadLevel(&game->level, config->levelData, innerOrigin, worldId))
+        GAME_LOG(SEVERITY_ERROR, LOGCAT_LEVEL, "Could not allocate level %s", config->levelPath);
+
+    game->ballRadius = 0.3f * lengthUnitsPerMeter;
+    InitBallPool(&game->balls, worldId);
+    ServeStartingBalls(game);
+}
+
+/**
+ * Start the level over without rebuilding the world. The level's targets, the boxes, the balls and the paddle
+ * go back to where they started, reusing their bodies, and the score, the clock and the RNG start over.
+ * To switch levels instead, point config.levelData and config.levelPath at another level first.
+ * @return False if a new level's memory could not be allocated, in which case the old level was restarted
+ */
+bool RestartLevel(GameContext* game) {
+    bool switched = ResetLevel(&game->level, game->config.levelData);
+    if (!switched)
+        GAME_LOG(SEVERITY_ERROR, LOGCAT_LEVEL, "Could not allocate level %s", game->config.levelPath);
+    ResetBoxes(game);
+
+    Paddle* paddle = &game->paddle;
+    b2Body_SetTransform(paddle->bodyId, PaddleSpawn(&game->config), b2Rot_identity);
+    b2Body_SetLinearVelocity(paddle->bodyId, b2Vec2_zero);
+    b2Body_SetAngularVelocity(paddle->bodyId, 0.0f);
+    paddle->lastTouchTime = 0.0f;
+    paddle->timeDelta = 0.0f;
+    paddle->tilt = 0;
+
+    game->gameState.paused = false;
+    game->gameState.state = GAME_ACTIVE;
+    game->gameState.score = 0;
+    SeedRandom(&game->random, game->config.seed);
+    game->simulationTime = 0.0f;
+    game->holdingEntity = false;
+    game->lastHeldEntity = nullptr;
+    ForgetHistory(game);
+    ServeStartingBalls(game);
+    // Everything was teleported, so nothing should be drawn blending in from where it was
+    if (game->config.presented)
+        InterpolationReset(game->worldId);
+    return switched;
+}
+
+/**
+ * Put a ball at rest at the level's ball spawn.
+ * @param index Balls after the first are laid out in rows of 16 around the spawn, so they don't overlap
+ * @return The ball's slot, or -1 if the pool is full
+ */
+int SpawnPlayerBall(GameContext* game, int index) {
+    int column = index % 16;
+    int row = index / 16;
+    float spacing = 2.5f * game->ballRadius;
+    b2Vec2 offset = {
+        (float)((column + 1) / 2) * (column % 2 ? spacing : -spacing),
+        -row * spacing
+    };
+    return SpawnBall(&game->balls, b2Add(game->ballSpawn, offset), b2Vec2_zero, game->ballRadius, t_ball, PURPLE);
+}
+
+/**
+ * Multiball: every ball in play splits into three, the new ones fanning out from its velocity.
+ */
+void SplitBalls(GameContext* game) {
+    BallPool* balls = &game->balls;
+    int count = balls->activeCount;
+    for (int i = 0; i < count; i++) {
+        int slot = balls->active[i];
+        b2Vec2 position = balls->positions[slot];
+        b2Vec2 velocity = b2Body_GetLinearVelocity(balls->bodyIds[slot]);
+        for (int side = -1; side <= 1; side += 2) {
+            b2Vec2 offset = {side * 2.2f * balls->radii[slot], 0};
+            b2Vec2 fanned = b2RotateVector(b2MakeRot(side * 0.3f), velocity);
+            if (SpawnBall(balls, b2Add(position, offset), fanned, balls->radii[slot], balls->sprites[slot], balls->colors[slot]) < 0)
+                return;
+        }
+    }
+}
+
+/**
+ * Tear down everything InitWorld created, so that InitWorld can be called again.
+ * Textures and sounds are owned by the asset libraries and survive.
+ */
+void DestroyWorld(GameContext* game) {
+    DestroyWorldLocked(game->worldId);
+    game->worldId = b2_nullWorldId;
+    UnloadLevel(&game->level);
+    MemArenaFree(&game->boxArena);
+    for (int i = 0; i < SNAPSHOT_HISTORY; i++)
+        FreeSnapshot(game->history + i);
+    FreeSnapshot(&game->shotStart);
+    game->historyCount = 0;
+    memset(&game->debris, 0, sizeof game->debris);
+    game->boxSpawns = nullptr;
+    game->boxCount = 0;
+    if (game->pauseMenu != nullptr) {
+        DestroyPauseMenu(game->pauseMenu);
+        game->pauseMenu = nullptr;
+    }
+}
+
+/**
+ * Advance the world by one tick.
+ * @param input The tick's input, in screen coordinates
+ */
+void Update(GameContext* game, const InputState* input, float deltaTime) {
+    ProfileBegin(PROFILE_GAMEPLAY);
+    float height = (float)game->config.height;
+    Paddle* paddle = &game->paddle;
+    BallPool* balls = &game->balls;
+    game->mouseInWorld = GetScreenToWorld2D(game->mousePosition, game->camera);
+    if (input->pressed & INPUT_KEY_PAUSE)
+    {
+        game->gameState.paused = !game->gameState.paused;
+    }
+
+    // Reset boxes and ball
+    if (input->pressed & INPUT_KEY_RESET_BOXES) {
+        ResetBoxes(game);
+    }
+
+    if (input->pressed & INPUT_KEY_RESTART) {
+        RestartLevel(game);
+    }
+
+    // Retry the last shot from a moment before the ball met the paddle
+    if ((input->pressed & INPUT_KEY_RETRY) && RestoreSnapshot(&game->shotStart, game)) {
+        game->historyCount = 0;
+        if (game->config.presented)
+            InterpolationReset(game->worldId);
+    }
+    if (!game->gameState.paused)
+        RecordHistory(game);
+
+    if (input->pressed & INPUT_KEY_RESET_BALL) {
+        DespawnAllBalls(balls);
+        SpawnPlayerBall(game, 0);
+    }
+
+    if (input->pressed & INPUT_KEY_MULTIBALL) {
+        SplitBalls(game);
+    }
+
+    if (input->down & INPUT_KEY_ROTATE_RIGHT) {
+        game->camera.rotation += 5;
+    }
+
+    if (input->down & INPUT_KEY_ROTATE_LEFT) {
+        game->camera.rotation -= 5;
+    }
+
+    // ######################
+    // Game and physics logic
+    // #######################
+
+    game->mousePosition = input->mousePosition;
+
+    game->mouseInWorld = GetScreenToWorld2D(game->mousePosition, game->camera);
+    b2Vec2 mVec = (b2Vec2){game->mouseInWorld.x, game->mouseInWorld.y};
+    game->mVec = mVec;
+
+    memset(game->VectorsToDraw, 0, sizeof game->VectorsToDraw);
+
+    paddle->tilt = 0;
+    if (input->down & (INPUT_MOUSE_LEFT | INPUT_MOUSE_RIGHT)) {
+        // Mouse left allows picking up a box
+        if ((input->down & INPUT_MOUSE_LEFT) && !game->holdingEntity) {
+            paddle->tilt = -1;
+            // Set variables required for holding a box (logic is applied later)
+            Entity* picked = PickBox(game, mVec);
+            if (picked != nullptr) {
+                game->holdingEntity = true;
+                game->lastHeldEntity = picked;
+            }
+        }
+        // Mouse right creates a radial force-field that pushes the boxes away based on the distance to the mouse
+        else if (input->down & INPUT_MOUSE_RIGHT) {
+            paddle->tilt = 1;
+            ApplyForceField(game, mVec);
+        }
+    }
+
+    // Logic for ensuring a held box follows the mouse cursor
+    Entity* held = game->lastHeldEntity;
+    if (game->holdingEntity && held != NULL) {
+        //b2Body_SetTransform(held->bodyId, mVec, b2Body_GetRotation(held->bodyId));
+        //b2Body_SetLinearVelocity(held->bodyId, (b2Vec2){0, 0});
+        b2Transform target = {
+            mVec,
+            b2Body_GetRotation(held->bodyId)
+        };
+        b2Body_SetTargetTransform(held->bodyId, target, 0.1f);
+    }
+
+    // Logic for releasing a held box
+    if (!(input->down & INPUT_MOUSE_LEFT) && game->holdingEntity && held != NULL) {
+        game->holdingEntity = false;
+    }
+
+    if ((input->pressed & INPUT_MOUSE_LEFT) && game->pauseMenu != nullptr) {
+        PauseMenuHandleClick(game->pauseMenu, game->mouseInWorld);
+    }
+
+    // Balls that hit the death zone leave play, and the last one is replaced at the spawn
+    int deadBalls[BALL_POOL_CAPACITY];
+    int deadCount = FindBallsInBox(balls, b2Body_GetTransform(game->deathZone.bodyId), game->deathZone.extent, deadBalls);
+    for (int i = 0; i < deadCount; i++)
+        DespawnBall(balls, deadBalls[i]);
+    if (balls->activeCount == 0)
+        SpawnPlayerBall(game, 0);
+
+    // Prevent high-velocity shots by having cursor above limit
+    b2Vec2 paddleTarget = mVec;
+    if (paddleTarget.y < height / 2.0f) {
+        paddleTarget.y = height / 2.0f;
+    }
+    b2Vec2 paddlePos = b2Body_GetPosition(paddle->bodyId);
+    float limitBottom = b2Body_GetPosition(game->limit.bodyId).y + game->limit.extent.y;
+    if (paddleTarget.y <= paddlePos.y && paddle->touchingLimit && paddle->timeDelta > 0.1f) {
+        paddleTarget.y = limitBottom + paddle->extent.y;
+    }
+    game->paddleTarget = paddleTarget;
+
+    ProfileEnd(PROFILE_GAMEPLAY);
+
+    // Raycast Collision
+    ProfileBegin(PROFILE_TRAJECTORY);
+
+    // Reset the ballcast result
+    BallRayCastContext* context = &game->paddleCast;
+    memset(context, 0, sizeof(*context));
+
+    context->targetShapeId = paddle->shapeId;
+    game->trackedBall = LowestBall(balls);
+    int trackedBall = game->trackedBall;
+    if (trackedBall >= 0) {
+        // The path is only predicted again when the ball strays from it or the level changes
+        UpdateTrajectory(&game->trajectory, game->worldId, balls->bodyIds[trackedBall], balls->radii[trackedBall], deltaTime, game->geometryVersion);
+        // The paddle moves every tick, so it is checked against the cached path instead of being part of it
+        TrajectoryHit paddleHit;
+        if (FindTrajectoryContact(&game->trajectory, paddle->proxy, b2Body_GetTransform(paddle->bodyId), b2Shape_GetAABB(paddle->shapeId), &paddleHit)) {
+            context->shapeId = paddle->shapeId;
+            context->point = paddleHit.point;
+            context->normal = paddleHit.normal;
+        }
+    }
+    else {
+        ResetTrajectory(&game->trajectory);
+    }
+
+    if (context->shapeId.index1 == paddle->shapeId.index1)
+        GAME_LOG(SEVERITY_DEBUG, LOGCAT_PADDLE, "Context: ShapeID: %d, Point: (%.2f, %.2f), Normal: (%.2f, %.2f)", context->shapeId.index1, context->point.x, context->point.y, context->normal.x, context->normal.y);
+
+    ProfileEnd(PROFILE_TRAJECTORY);
+
+    // Set the paddle velocity required to approach the cursor the next timestep
+    ProfileBegin(PROFILE_PADDLE);
+    UpdatePaddle(paddle, paddleTarget, game->simulationTime);
+
+    // Get the magnitude of the paddle velocity
+    b2Vec2 paddleVelocity = b2Body_GetLinearVelocity(paddle->bodyId);
+    float paddleSpeed = sqrt(paddleVelocity.x * paddleVelocity.x + paddleVelocity.y * paddleVelocity.y);
+
+    // If paddle is moving fast enough, perform extra collision checks to prevent tunneling
+    if(paddleSpeed > 2000.0f){
+        GAME_LOG(SEVERITY_DEBUG, LOGCAT_PADDLE, "Paddlespeed: %.4f", paddleSpeed);
+        CheckBallPaddleCollision(balls, trackedBall, paddle, context, deltaTime);
+    }
+    ProfileEnd(PROFILE_PADDLE);
+
+    if (game->gameState.paused == false)
+    {
+        ProfileBegin(PROFILE_STEP);
+        b2World_Step(game->worldId, deltaTime, 16);
+        ProfileEnd(PROFILE_STEP);
+        ProfilerRecordWorld(game->worldId);
+        RecordBallTrails(balls);
+        if (DespawnDebrisOutside(&game->debris, game->debrisBounds) > 0 && game->holdingEntity
+            && !b2Body_IsEnabled(game->lastHeldEntity->bodyId)) {
+            game->holdingEntity = false;
+            game->lastHeldEntity = nullptr;
+        }
+        game->simulationTime += deltaTime;
+        if (game->config.presented)
+            InterpolationRecordStep(game->worldId);
+    }
+
+    // #################
+    // Collision logic
+    // #################
+    ProfileBegin(PROFILE_EVENTS);
+    b2ContactEvents contactEvents = b2World_GetContactEvents(game->worldId);
+    if (contactEvents.beginCount > 0 || contactEvents.endCount > 0 || contactEvents.hitCount > 0 )
+        GAME_LOG(SEVERITY_DEBUG, LOGCAT_CONTACTS, "Contact begin: %d, Contact end: %d, Hits: %d", contactEvents.beginCount, contactEvents.endCount, contactEvents.hitCount);
+
+    game->paddleHit = false;
+    DispatchContactEvents(&game->contactDispatcher, contactEvents, game);
+    if (game->paddleHit)
+        KeepShotStart(game);
+    ProfileEnd(PROFILE_EVENTS);
+}
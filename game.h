@@ -0,0 +1,132 @@
+//
+// Created by frick on 2025-07-27.
+//
+
+#ifndef GAME_H
+#define GAME_H
+
+#include "box2d/types.h"
+#include "raylib.h"
+#include "balls.h"
+#include "debris.h"
+#include "dispatch.h"
+#include "entities.h"
+#include "input.h"
+#include "interface.h"
+#include "levels.h"
+#include "memarena.h"
+#include "rng.h"
+#include "snapshot.h"
+#include "trajectory.h"
+#include <stdint.h>
+
+// Boxes in the sandbox by default, and at most
+#define BOX_COUNT 10
+constexpr int MAX_BOXES = 4096;
+
+// Ticks of snapshots kept, so a shot can be retried from a moment before the ball met the paddle
+constexpr int SNAPSHOT_HISTORY = 30;
+
+// 128 pixels per meter is a appropriate for this scene. The boxes are 128 pixels wide.
+constexpr float LENGTH_UNITS_PER_METER = 128.0f;
+
+/**
+ * What a world is built from. It is only read, so any number of worlds can share one.
+ */
+typedef struct GameConfig {
+    const LevelData* levelData;
+    // For messages only
+    const char* levelPath;
+    uint64_t seed;
+    int startingBalls;
+    // Up to MAX_BOXES. More than BOX_COUNT are laid out in a grid, shrunk to fit the arena.
+    int boxCount;
+    int width;
+    int height;
+    // The world on screen draws its pause menu, plays sounds and records its bodies for interpolation
+    bool presented;
+    // Keep the snapshots a retry restores. Any world whose input may hold a retry press needs them.
+    bool keepHistory;
+    // Run box2d's solver on the job system. Worlds that are themselves run in parallel step on one thread.
+    bool parallelSolver;
+} GameConfig;
+
+/**
+ * The boxes found near the cursor by a broadphase query, as parallel arrays for the force-field kernel.
+ * Every array has room for all of the world's boxes.
+ */
+typedef struct BoxQuery {
+    int* boxes;
+    float* x;
+    float* y;
+    float* vx;
+    float* vy;
+    uint8_t* inside;
+    int count;
+    int capacity;
+} BoxQuery;
+
+/**
+ * Everything one running world is made of. Worlds share nothing they write, so each can be updated on its
+ * own thread. The assets they read are loaded before any world is built.
+ */
+typedef struct GameContext {
+    GameConfig config;
+    b2WorldId worldId;
+    Level level;
+    Camera2D camera;
+    Rectangle screenBounds;
+    GameState gameState;
+    PauseMenu* pauseMenu;
+    Random random;
+    ContactDispatcher contactDispatcher;
+    float simulationTime;
+
+    // The boxes and their query scratch, carved from boxArena
+    MemArena boxArena;
+    DebrisPool debris;
+    // Where each of the boxCount boxes starts, and where the reset key puts them back
+    b2Vec2* boxSpawns;
+    b2Vec2 boxExtent;
+    int boxCount;
+    BoxQuery boxQuery;
+    // Boxes that leave this are despawned
+    b2AABB debrisBounds;
+    Entity leftWall, rightWall, ceiling, limit, deathZone;
+    Paddle paddle;
+
+    BallPool balls;
+    // The ball the trajectory is cast for, the lowest one in play
+    int trackedBall;
+    b2Vec2 ballSpawn;
+    float ballRadius;
+    Trajectory trajectory;
+    // Bumped whenever the level's shapes change, so the trajectory is predicted again
+    uint32_t geometryVersion;
+    // Where the tracked ball is predicted to meet the paddle
+    BallRayCastContext paddleCast;
+
+    Vector2 mousePosition;
+    Vector2 mouseInWorld;
+    b2Vec2 mVec;
+    b2Vec2 paddleTarget;
+    bool holdingEntity;
+    Entity* lastHeldEntity;
+    b2Vec2 VectorsToDraw[BOX_COUNT];
+
+    // The world on screen snapshots every tick into a ring, and keeps the oldest one when the ball meets the paddle
+    GameSnapshot history[SNAPSHOT_HISTORY];
+    int historyHead;
+    int historyCount;
+    GameSnapshot shotStart;
+    bool paddleHit;
+} GameContext;
+
+void InitWorld(GameContext* game, const GameConfig* config);
+void DestroyWorld(GameContext* game);
+bool RestartLevel(GameContext* game);
+void Update(GameContext* game, const InputState* input, float deltaTime);
+int SpawnPlayerBall(GameContext* game, int index);
+void SplitBalls(GameContext* game);
+
+#endif //GAME_H
@@ -0,0 +1,79 @@
+//
+// Created by frick on 2025-07-14.
+//
+
+#include "input.h"
+#include "raylib.h"
+
+#include <math.h>
+
+typedef struct KeyBinding {
+    int key;
+    uint32_t button;
+} KeyBinding;
+
+static const KeyBinding keyBindings[] = {
+    {KEY_P, INPUT_KEY_PAUSE},
+    {KEY_R, INPUT_KEY_RESET_BOXES},
+    {KEY_T, INPUT_KEY_RESET_BALL},
+    {KEY_M, INPUT_KEY_MULTIBALL},
+    {KEY_L, INPUT_KEY_RESTART},
+    {KEY_Z, INPUT_KEY_RETRY},
+    {KEY_A, INPUT_KEY_ROTATE_LEFT},
+    {KEY_D, INPUT_KEY_ROTATE_RIGHT},
+    {KEY_F3, INPUT_KEY_PROFILER},
+    {KEY_F4, INPUT_KEY_PROFILER_DUMP},
+};
+
+/**
+ * Sample the mouse and keyboard through raylib. Requires an open window.
+ * @return The current input state
+ */
+InputState PollInput(void) {
+    InputState input = { 0 };
+    input.mousePosition = GetMousePosition();
+
+    if (IsMouseButtonDown(MOUSE_BUTTON_LEFT))
+        input.down |= INPUT_MOUSE_LEFT;
+    if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT))
+        input.down |= INPUT_MOUSE_RIGHT;
+    if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+        input.pressed |= INPUT_MOUSE_LEFT;
+    if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT))
+        input.pressed |= INPUT_MOUSE_RIGHT;
+
+    for (int i = 0; i < (int)(sizeof keyBindings / sizeof keyBindings[0]); i++) {
+        if (IsKeyDown(keyBindings[i].key))
+            input.down |= keyBindings[i].button;
+        if (IsKeyPressed(keyBindings[i].key))
+            input.pressed |= keyBindings[i].button;
+    }
+    return input;
+}
+
+/**
+ * A deterministic stand-in for a player, used when running without a window.
+ * The cursor shadows the ball from below and periodically flicks upwards to smack it,
+ * pulses the force-field now and then and resets the ball every 20 seconds (at 60 Hz).
+ * @param tick The simulation tick being played
+ * @param ballOnScreen The ball's position in screen coordinates
+ * @param screenSize The size of the (virtual) screen
+ * @return The input for this tick
+ */
+InputState ScriptedInput(uint64_t tick, Vector2 ballOnScreen, Vector2 screenSize) {
+    InputState input = { 0 };
+    float sway = 40.0f * sinf((float)tick * 0.05f);
+    float flick = (tick % 90 < 10) ? -150.0f : 0.0f;
+    input.mousePosition = (Vector2){
+        ballOnScreen.x + sway,
+        screenSize.y * 0.9f + flick
+    };
+
+    if (tick % 600 >= 300 && tick % 600 < 330)
+        input.down |= INPUT_MOUSE_RIGHT;
+    if (tick % 600 == 300)
+        input.pressed |= INPUT_MOUSE_RIGHT;
+    if (tick > 0 && tick % 1200 == 0)
+        input.pressed |= INPUT_KEY_RESET_BALL;
+    return input;
+}
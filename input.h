@@ -0,0 +1,41 @@
+//
+// Created by frick on 2025-07-14.
+//
+
+#ifndef INPUT_H
+#define INPUT_H
+#include <raylib.h>
+#include <stdint.h>
+
+/**
+ * Every button or key the simulation reacts to, as a bit in InputState.down / InputState.pressed.
+ */
+enum InputButtons {
+    INPUT_MOUSE_LEFT = 1 << 0,
+    INPUT_MOUSE_RIGHT = 1 << 1,
+    INPUT_KEY_PAUSE = 1 << 2,
+    INPUT_KEY_RESET_BOXES = 1 << 3,
+    INPUT_KEY_RESET_BALL = 1 << 4,
+    INPUT_KEY_ROTATE_LEFT = 1 << 5,
+    INPUT_KEY_ROTATE_RIGHT = 1 << 6,
+    INPUT_KEY_PROFILER = 1 << 7,
+    INPUT_KEY_PROFILER_DUMP = 1 << 8,
+    INPUT_KEY_MULTIBALL = 1 << 9,
+    INPUT_KEY_RESTART = 1 << 10,
+    INPUT_KEY_RETRY = 1 << 11,
+};
+
+/**
+ * One tick's worth of player input. Update() only ever reads input through this struct,
+ * so the simulation can be driven by raylib, a script or anything else.
+ */
+typedef struct InputState {
+    Vector2 mousePosition;
+    uint32_t down;
+    uint32_t pressed;
+} InputState;
+
+InputState PollInput(void);
+InputState ScriptedInput(uint64_t tick, Vector2 ballOnScreen, Vector2 screenSize);
+
+#endif //INPUT_H
@@ -4,6 +4,9 @@
 
 #include "interface.h"
 #include "raylib.h"
+#include "rlgl.h"
+#include "logger.h"
+#include "sprites.h"
 #include "sys/types.h"
 
 #include <math.h>
@@ -61,28 +64,20 @@ Container CreateContainer(Rectangle parentBounds, Rectangle containerBounds, Col
     return container;
 }
 
-Button CreateButton(Container* parent, bool centered, Rectangle buttonBounds, Font* font, const char text[16], Texture* texture, void* callback, int* callbackArg) {
+Button CreateButton(Container* parent, bool centered, Rectangle buttonBounds, Font* font, const char text[16], int sprite, void* callback, int* callbackArg) {
     Rectangle relativeRect;
     if (centered)
         relativeRect = RelToAbsCentered(parent->bounds, buttonBounds);
     else
         relativeRect = RelToAbs(parent->bounds, buttonBounds);
 
-    Image imageText = ImageTextEx(*font, text, 75, 0.1f, WHITE);
-    Texture img = LoadTextureFromImage(imageText);
-    Vector2 textPos = {
-        (relativeRect.x + (relativeRect.width / 2)) - img.width / 2,
-        (relativeRect.y + (relativeRect.height / 2)) - img.height / 2};
-
-    Texture modTex = *texture;
-    modTex.width = relativeRect.width;
-    modTex.height = relativeRect.height;
+    // The label is rasterized when the button is first drawn, see LoadButtonLabel
     Button button = {
         .parent = parent,
+        .font = font,
         .bounds = relativeRect,
-        .texture = modTex,
-        .textAsImg = img,
-        .textPosition = textPos,
+        .sprite = sprite,
+        .textAsImg = (Texture){ 0 },
         .callback = callback,
         .callbackArg = callbackArg
     };
@@ -91,8 +86,23 @@ Button CreateButton(Container* parent, bool centered, Rectangle buttonBounds, Fo
     return button;
 }
 
+/**
+ * Rasterize a button's label and center it on the button. Needs the GL context, so it is left until the
+ * button is drawn; worlds that are never drawn still get their buttons' bounds and callbacks.
+ */
+static void LoadButtonLabel(Button* button) {
+    Image imageText = ImageTextEx(*button->font, button->text, 75, 0.1f, WHITE);
+    button->textAsImg = LoadTextureFromImage(imageText);
+    UnloadImage(imageText);
+    button->textPosition = (Vector2){
+        (button->bounds.x + (button->bounds.width / 2)) - button->textAsImg.width / 2,
+        (button->bounds.y + (button->bounds.height / 2)) - button->textAsImg.height / 2};
+}
+
 void DrawButton(Button* button) {
-    DrawTextureEx(button->texture, (Vector2){ button->bounds.x, button->bounds.y }, 0, 1.0f, WHITE);
+    DrawSpriteRec(button->sprite, button->bounds, WHITE);
+    // The label is its own texture and must end up on top of the button
+    FlushSprites();
     DrawTextureEx(button->textAsImg, button->textPosition, 0, 1.0f, WHITE);
 }
 
@@ -117,33 +127,112 @@ PauseMenu* CreatePauseMenu(GameState* gameState, Rectangle bounds) {
 
     Rectangle buttonDimensions = {0, 0, 50, 10};
 
-    Button resume = CreateButton(&foreground, true, buttonDimensions, &menuFont, "Resume", &TextureLibrary[t_ui_button_color], TogglePause, &(gameState->paused));
+    Button resume = CreateButton(&foreground, true, buttonDimensions, &menuFont, "Resume", t_ui_button_color, TogglePause, &(gameState->paused));
     menu->buttons[0] = resume;
 
     menu->gameState = gameState;
     menu->bounds = bounds;
     menu->background = background;
     menu->foreground = foreground;
+    menu->cache = (RenderTexture2D){ 0 };
+    menu->dirty = true;
+
+    // Buttons are not necessarily inside the menu's bounds, so the cache covers them all
+    Rectangle cacheBounds = bounds;
+    for (int i = 0; i < menu->buttonCount; i++) {
+        Rectangle b = menu->buttons[i].bounds;
+        float right = fmaxf(cacheBounds.x + cacheBounds.width, b.x + b.width);
+        float bottom = fmaxf(cacheBounds.y + cacheBounds.height, b.y + b.height);
+        cacheBounds.x = fminf(cacheBounds.x, b.x);
+        cacheBounds.y = fminf(cacheBounds.y, b.y);
+        cacheBounds.width = right - cacheBounds.x;
+        cacheBounds.height = bottom - cacheBounds.y;
+    }
+    menu->cacheBounds = cacheBounds;
 
     return menu;
 }
 
-void DrawPauseMenu(PauseMenu* pauseMenu) {
+/**
+ * Free a pause menu along with its button labels and cached texture, if it was ever drawn.
+ */
+void DestroyPauseMenu(PauseMenu* pauseMenu) {
+    for (int i = 0; i < pauseMenu->buttonCount; i++) {
+        if (pauseMenu->buttons[i].textAsImg.id != 0)
+            UnloadTexture(pauseMenu->buttons[i].textAsImg);
+    }
+    if (IsRenderTextureValid(pauseMenu->cache))
+        UnloadRenderTexture(pauseMenu->cache);
+    free(pauseMenu);
+}
+
+/*  #########################
+ *      CACHED UI LAYERS
+ *  #########################
+ *
+ * UI elements are composed into render textures and only redrawn when what they show changes.
+ * Sprites are not premultiplied, so the color is premultiplied while composing (keeping the
+ * texture's alpha correct) and the texture is drawn with premultiplied blending.
+ */
+
+static void BeginCachedLayer(RenderTexture2D target, Vector2 origin) {
+    BeginTextureMode(target);
+    ClearBackground(BLANK);
+    rlSetBlendFactorsSeparate(RL_SRC_ALPHA, RL_ONE_MINUS_SRC_ALPHA, RL_ONE, RL_ONE_MINUS_SRC_ALPHA, RL_FUNC_ADD, RL_FUNC_ADD);
+    BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+    BeginMode2D((Camera2D){ .target = origin, .zoom = 1.0f });
+}
+
+static void EndCachedLayer(void) {
+    FlushSprites();
+    EndMode2D();
+    EndBlendMode();
+    EndTextureMode();
+}
+
+static void DrawCachedLayer(RenderTexture2D cache, Vector2 position) {
+    // Render textures are stored upside down
+    Rectangle source = {0, 0, (float)cache.texture.width, -(float)cache.texture.height};
+    BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+    DrawTextureRec(cache.texture, source, position, WHITE);
+    EndBlendMode();
+}
+
+/**
+ * Compose the menu into its texture if it changed. Call outside BeginDrawing/EndDrawing.
+ */
+void UpdatePauseMenu(PauseMenu* pauseMenu) {
+    if (!pauseMenu->dirty)
+        return;
+    if (!IsRenderTextureValid(pauseMenu->cache))
+        pauseMenu->cache = LoadRenderTexture((int)ceilf(pauseMenu->cacheBounds.width), (int)ceilf(pauseMenu->cacheBounds.height));
+    for (int i = 0; i < pauseMenu->buttonCount; i++) {
+        if (pauseMenu->buttons[i].textAsImg.id == 0)
+            LoadButtonLabel(&pauseMenu->buttons[i]);
+    }
+
+    BeginCachedLayer(pauseMenu->cache, (Vector2){pauseMenu->cacheBounds.x, pauseMenu->cacheBounds.y});
     DrawRectanglePro(pauseMenu->bounds, (Vector2){ 0, 0 }, 0, RED);
     DrawRectanglePro(pauseMenu->foreground.bounds, (Vector2){ 0, 0 }, 0, GRAY);
     for (int i = 0; i < pauseMenu->buttonCount; i++) {
         DrawButton(&pauseMenu->buttons[i]);
     }
+    EndCachedLayer();
+    pauseMenu->dirty = false;
+}
+
+void DrawPauseMenu(PauseMenu* pauseMenu) {
+    DrawCachedLayer(pauseMenu->cache, (Vector2){pauseMenu->cacheBounds.x, pauseMenu->cacheBounds.y});
 }
 
 void PauseMenuHandleClick(PauseMenu* menu, Vector2 mousePos) {
-    printf("Mouse: (%.3f, %.3f) | Box: (%.3f -> %.3f; %.3f -> %.3f)\n",
+    GAME_LOG(SEVERITY_DEBUG, LOGCAT_UI, "Mouse: (%.3f, %.3f) | Box: (%.3f -> %.3f; %.3f -> %.3f)",
     mousePos.x, mousePos.y,
     menu->bounds.x, menu->bounds.y, menu->bounds.x + menu->bounds.width, menu->bounds.y + menu->bounds.height);
     if (CheckCollisionPointRec(mousePos, menu->bounds)) {
         for (int i = 0; i < menu->buttonCount; i++) {
             Button button = menu->buttons[i];
-            printf("    Mouse: (%.3f, %.3f) | Box: (%.3f -> %.3f; %.3f -> %.3f)\n",
+            GAME_LOG(SEVERITY_DEBUG, LOGCAT_UI, "    Mouse: (%.3f, %.3f) | Box: (%.3f -> %.3f; %.3f -> %.3f)",
             mousePos.x, mousePos.y,
             button.bounds.x, button.bounds.y, button.bounds.x + button.bounds.width, button.bounds.y + button.bounds.height);
             if (CheckCollisionPointRec(mousePos, button.bounds)) {
@@ -153,36 +242,51 @@ void PauseMenuHandleClick(PauseMenu* menu, Vector2 mousePos) {
     }
 }
 
-int * toArray(int number)
-{
-    int n;
-    if(number == 0)
-        n = 1;
-    else
-        n = log10(number) + 1;
-    int i;
-    int *numberArray = calloc(n, sizeof(int));
-    for ( i = 0; i < n; ++i, number /= 10 )
-    {
-        numberArray[i] = number % 10;
+static const Vector2 HUD_PADDING = {20, 20};
+static const float HUD_DIGIT_SPACING = 100.0f;
+
+/**
+ * Compose the score into the HUD's texture if it changed. Call outside BeginDrawing/EndDrawing.
+ */
+void UpdateHUD(HUD* hud, const GameState* gameState) {
+    if (hud->valid && hud->score == gameState->score)
+        return;
+    if (!IsRenderTextureValid(hud->cache)) {
+        Texture coin = TextureLibrary[t_ui_coin];
+        Texture digit = TextureLibrary[t_ui_number_0];
+        int width = (int)(HUD_DIGIT_SPACING * HUD_MAX_DIGITS) + digit.width;
+        int height = coin.height > digit.height ? coin.height : digit.height;
+        hud->cache = LoadRenderTexture(width > coin.width ? width : coin.width, height);
     }
-    return numberArray;
-}
 
+    // Least significant digit first
+    int digits[HUD_MAX_DIGITS];
+    int digitCount = 0;
+    unsigned int score = gameState->score > 0 ? (unsigned int)gameState->score : 0;
+    do {
+        digits[digitCount++] = (int)(score % 10);
+        score /= 10;
+    } while (score > 0 && digitCount < HUD_MAX_DIGITS);
+
+    BeginCachedLayer(hud->cache, (Vector2){0, 0});
+    DrawSprite(t_ui_coin, (Vector2){0, 0}, 0, 1.0f, WHITE);
+    for (int i = 0; i < digitCount; i++) {
+        DrawSprite(t_ui_number_0 + digits[i], (Vector2){HUD_DIGIT_SPACING * (digitCount - i), 0}, 0, 1.0f, WHITE);
+    }
+    EndCachedLayer();
 
-void DrawHUD(GameState *gameState, Rectangle screenBounds) {
-    Vector2 scorePadding = {20, 20};
-    DrawTexture(TextureLibrary[t_ui_coin], screenBounds.x + scorePadding.x, screenBounds.y + scorePadding.y, WHITE);
+    hud->score = gameState->score;
+    hud->valid = true;
+}
 
+void DrawHUD(const HUD* hud, Rectangle screenBounds) {
+    if (!hud->valid)
+        return;
+    DrawCachedLayer(hud->cache, (Vector2){screenBounds.x + HUD_PADDING.x, screenBounds.y + HUD_PADDING.y});
+}
 
-    int* asArray = toArray(gameState->score);
-    int numberLength = 1;
-    if(gameState->score > 0)
-        numberLength = log10(gameState->score) + 1;
-    int j = numberLength;
-    for (int i = 0; i < numberLength; i++) {
-        DrawTexture(TextureLibrary[t_ui_number_0 + asArray[i]], screenBounds.x + scorePadding.x + 100 * j, screenBounds.y + scorePadding.y, WHITE);
-        j--;
-    }
-    free(asArray);
-}
\ No newline at end of file
+void UnloadHUD(HUD* hud) {
+    if (IsRenderTextureValid(hud->cache))
+        UnloadRenderTexture(hud->cache);
+    *hud = (HUD){ 0 };
+}
@@ -31,7 +31,7 @@ typedef struct Button {
     Container* parent;
     Font* font;
     Rectangle bounds;
-    Texture texture;
+    int sprite;
     char text[16];
     Texture textAsImg;
     Vector2 textPosition;
@@ -44,14 +44,34 @@ typedef struct PauseMenu {
     Rectangle bounds;
     Container background;
     Container foreground;
+    // The whole menu, composed once into a texture covering cacheBounds
+    RenderTexture2D cache;
+    Rectangle cacheBounds;
+    bool dirty;
     int buttonCount;
     Button buttons[];
 } PauseMenu;
 
 PauseMenu* CreatePauseMenu(GameState* gameState, Rectangle bounds);
+void DestroyPauseMenu(PauseMenu* pauseMenu);
+void UpdatePauseMenu(PauseMenu* pauseMenu);
 void DrawPauseMenu(PauseMenu* pauseMenu);
 void PauseMenuHandleClick(PauseMenu* pauseMenu, Vector2 mousePos);
 
-void DrawHUD(GameState* gameState, Rectangle screenBounds);
+// Digits the HUD has room for
+constexpr int HUD_MAX_DIGITS = 10;
+
+/**
+ * The score display, composed into a texture whenever the score changes.
+ */
+typedef struct HUD {
+    RenderTexture2D cache;
+    int score;
+    bool valid;
+} HUD;
+
+void UpdateHUD(HUD* hud, const GameState* gameState);
+void DrawHUD(const HUD* hud, Rectangle screenBounds);
+void UnloadHUD(HUD* hud);
 
 #endif //INTERFACE_H
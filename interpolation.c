@@ -0,0 +1,130 @@
+//
+// Created by frick on 2025-07-15.
+//
+
+#include "interpolation.h"
+#include <box2d/box2d.h>
+#include <box2d/math_functions.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The simulation runs at a fixed tick rate while frames are drawn whenever the display wants them,
+ * so a frame usually lands somewhere between two ticks. For every body that moved during the last
+ * tick we keep its transform before and after that tick, and draw it blended by how far the frame
+ * is into the next tick. Bodies are looked up by their index, which box2d keeps dense.
+ * Only the world on screen is tracked; worlds simulated alongside it leave the history alone.
+ */
+
+typedef struct BodyHistory {
+    b2Transform previous;
+    b2Transform current;
+    uint64_t step;
+    uint16_t generation;
+    bool valid;
+} BodyHistory;
+
+static BodyHistory* history = nullptr;
+static int historyCapacity = 0;
+static uint64_t stepCount = 0;
+static float renderAlpha = 1.0f;
+static b2WorldId renderedWorld = { 0 };
+
+static bool IsRendered(b2BodyId bodyId) {
+    return (int)bodyId.world0 + 1 == renderedWorld.index1;
+}
+
+/**
+ * @return The body's entry, grown into if needed, or null if the history could not grow
+ */
+static BodyHistory* GetHistory(b2BodyId bodyId) {
+    if (bodyId.index1 >= historyCapacity) {
+        int capacity = historyCapacity > 0 ? historyCapacity : 64;
+        while (capacity <= bodyId.index1)
+            capacity *= 2;
+        BodyHistory* grown = realloc(history, capacity * sizeof(BodyHistory));
+        if (grown == nullptr)
+            return nullptr;
+        history = grown;
+        memset(history + historyCapacity, 0, (capacity - historyCapacity) * sizeof(BodyHistory));
+        historyCapacity = capacity;
+    }
+    return history + bodyId.index1;
+}
+
+/**
+ * Forget every recorded transform. Call whenever the world on screen is rebuilt.
+ * @param worldId The world that will be drawn
+ */
+void InterpolationReset(b2WorldId worldId) {
+    renderedWorld = worldId;
+    if (history != nullptr)
+        memset(history, 0, historyCapacity * sizeof(BodyHistory));
+    stepCount = 0;
+    renderAlpha = 1.0f;
+}
+
+/**
+ * Record the transforms of every body that moved during the step that was just taken.
+ * Costs O(moving bodies), since it only walks box2d's move events.
+ * @param worldId The world that was just stepped
+ */
+void InterpolationRecordStep(b2WorldId worldId) {
+    if (worldId.index1 != renderedWorld.index1 || worldId.generation != renderedWorld.generation)
+        return;
+    stepCount++;
+    b2BodyEvents events = b2World_GetBodyEvents(worldId);
+    for (int i = 0; i < events.moveCount; i++) {
+        const b2BodyMoveEvent* event = events.moveEvents + i;
+        BodyHistory* entry = GetHistory(event->bodyId);
+        // Out of memory: the body is drawn where it is, unblended
+        if (entry == nullptr)
+            continue;
+        // A body we have not seen before (or a recycled index) has nothing to blend from
+        if (entry->valid && entry->generation == event->bodyId.generation)
+            entry->previous = entry->current;
+        else
+            entry->previous = event->transform;
+        entry->current = event->transform;
+        entry->step = stepCount;
+        entry->generation = event->bodyId.generation;
+        entry->valid = true;
+    }
+}
+
+/**
+ * Stop blending a body from where it was, e.g. after it has been teleported with b2Body_SetTransform.
+ * @param bodyId The body that jumped
+ */
+void InterpolationSnap(b2BodyId bodyId) {
+    if (IsRendered(bodyId) && bodyId.index1 < historyCapacity)
+        history[bodyId.index1].valid = false;
+}
+
+/**
+ * @param alpha How far the frame being drawn is between the last tick (0) and the next (1)
+ */
+void SetInterpolationAlpha(float alpha) {
+    renderAlpha = b2ClampFloat(alpha, 0.0f, 1.0f);
+}
+
+/**
+ * Get the transform a body should be drawn with this frame.
+ * Bodies that did not move during the last tick are drawn where they are.
+ * @param bodyId The body to draw
+ * @return The body's transform blended between the last two ticks
+ */
+b2Transform GetRenderTransform(b2BodyId bodyId) {
+    if (bodyId.index1 < historyCapacity) {
+        const BodyHistory* entry = history + bodyId.index1;
+        if (entry->valid && entry->step == stepCount && entry->generation == bodyId.generation) {
+            b2Transform transform = {
+                b2Lerp(entry->previous.p, entry->current.p, renderAlpha),
+                b2NLerp(entry->previous.q, entry->current.q, renderAlpha)
+            };
+            return transform;
+        }
+    }
+    return b2Body_GetTransform(bodyId);
+}
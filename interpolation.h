@@ -0,0 +1,15 @@
+//
+// Created by frick on 2025-07-15.
+//
+
+#ifndef INTERPOLATION_H
+#define INTERPOLATION_H
+#include <box2d/types.h>
+
+void InterpolationReset(b2WorldId worldId);
+void InterpolationRecordStep(b2WorldId worldId);
+void InterpolationSnap(b2BodyId bodyId);
+void SetInterpolationAlpha(float alpha);
+b2Transform GetRenderTransform(b2BodyId bodyId);
+
+#endif //INTERPOLATION_H
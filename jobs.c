@@ -0,0 +1,331 @@
+//
+// Created by frick on 2025-07-27.
+//
+
+#include "jobs.h"
+#include "logger.h"
+
+#include <stdatomic.h>
+
+#if defined(PLATFORM_WEB) || defined(__EMSCRIPTEN__)
+    #define JOBS_NO_THREAD
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+#endif
+
+constexpr int JOB_QUEUE_CAPACITY = 256;
+constexpr int JOB_MAX_GROUPS = 64;
+// A loop is cut into this many jobs per worker, so that whoever finishes early has something to steal
+constexpr int JOB_SPLIT_PER_WORKER = 4;
+// Empty polls before an idle worker sleeps. box2d hands out dozens of short tasks per step,
+// and a worker woken from sleep would often arrive after they are done.
+constexpr int JOB_SPIN_COUNT = 2000;
+constexpr uint32_t JOB_NOT_A_WORKER = UINT32_MAX;
+
+static int workerCount = 1;
+// The thread that called JobsInit is worker 0, the pool's threads are 1 and up
+static thread_local uint32_t currentWorker = JOB_NOT_A_WORKER;
+// How many jobs this thread is inside of. A loop started from inside a job runs inline, see ParallelFor.
+static thread_local int jobDepth = 0;
+
+#ifndef JOBS_NO_THREAD
+/*
+ * Every worker owns a deque of jobs. The owner pops from the bottom, newest first, while an idle worker steals
+ * the oldest job from the top of another's. A loop's jobs are dealt out round robin across the deques, so every
+ * worker starts on its own share and stealing only evens out the slices that take longer than the rest.
+ * The deques hold a handful of jobs for microseconds at a time, so a lock each is cheap enough.
+ */
+
+typedef struct JobGroup {
+    atomic_int pending;
+    atomic_bool inUse;
+} JobGroup;
+
+typedef struct Job {
+    JobFcn* fcn;
+    void* context;
+    int startIndex;
+    int endIndex;
+    // Only workers below this may run the job, see JobsConfigureWorld
+    int workerLimit;
+    JobGroup* group;
+} Job;
+
+typedef struct JobQueue {
+    pthread_mutex_t lock;
+    int top;
+    int bottom;
+    Job jobs[JOB_QUEUE_CAPACITY];
+} JobQueue;
+
+static JobQueue queues[JOB_MAX_WORKERS];
+static pthread_t threads[JOB_MAX_WORKERS];
+// Groups for box2d's tasks, which outlive the call that starts them
+static JobGroup worldGroups[JOB_MAX_GROUPS];
+static atomic_int queuedJobs = 0;
+// Where the next single-job loop goes, so single jobs submitted back to back land on different workers
+static atomic_uint nextSingleQueue = 0;
+static atomic_bool running = false;
+static pthread_mutex_t sleepLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeUp = PTHREAD_COND_INITIALIZER;
+
+static bool PushJob(JobQueue* queue, const Job* job) {
+    pthread_mutex_lock(&queue->lock);
+    bool pushed = queue->bottom - queue->top < JOB_QUEUE_CAPACITY;
+    if (pushed) {
+        queue->jobs[queue->bottom % JOB_QUEUE_CAPACITY] = *job;
+        queue->bottom++;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return pushed;
+}
+
+static bool PopJob(JobQueue* queue, Job* job) {
+    pthread_mutex_lock(&queue->lock);
+    bool popped = queue->bottom > queue->top;
+    if (popped) {
+        queue->bottom--;
+        *job = queue->jobs[queue->bottom % JOB_QUEUE_CAPACITY];
+    }
+    if (queue->bottom == queue->top)
+        queue->bottom = queue->top = 0;
+    pthread_mutex_unlock(&queue->lock);
+    return popped;
+}
+
+static bool StealJob(JobQueue* queue, uint32_t thief, Job* job) {
+    pthread_mutex_lock(&queue->lock);
+    bool stolen = queue->bottom > queue->top && (uint32_t)queue->jobs[queue->top % JOB_QUEUE_CAPACITY].workerLimit > thief;
+    if (stolen) {
+        *job = queue->jobs[queue->top % JOB_QUEUE_CAPACITY];
+        queue->top++;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return stolen;
+}
+
+/**
+ * Run one job, from the worker's own deque if it has any, otherwise stolen from another.
+ * @return False if there was nothing this worker may run
+ */
+static bool RunOneJob(uint32_t worker) {
+    Job job;
+    bool found = PopJob(&queues[worker], &job);
+    for (int i = 1; !found && i < workerCount; i++)
+        found = StealJob(&queues[(worker + i) % workerCount], worker, &job);
+    if (!found)
+        return false;
+    atomic_fetch_sub_explicit(&queuedJobs, 1, memory_order_relaxed);
+    jobDepth++;
+    job.fcn(job.startIndex, job.endIndex, worker, job.context);
+    jobDepth--;
+    // Last touch of the group: once pending reaches zero its owner may reuse or free it
+    atomic_fetch_sub_explicit(&job.group->pending, 1, memory_order_release);
+    return true;
+}
+
+static void* WorkerMain(void* argument) {
+    currentWorker = (uint32_t)(uintptr_t)argument;
+    int idle = 0;
+    while (atomic_load_explicit(&running, memory_order_relaxed)) {
+        if (atomic_load_explicit(&queuedJobs, memory_order_acquire) > 0 && RunOneJob(currentWorker)) {
+            idle = 0;
+            continue;
+        }
+        if (++idle < JOB_SPIN_COUNT)
+            continue;
+        idle = 0;
+        pthread_mutex_lock(&sleepLock);
+        while (atomic_load(&running) && atomic_load(&queuedJobs) == 0)
+            pthread_cond_wait(&wakeUp, &sleepLock);
+        pthread_mutex_unlock(&sleepLock);
+    }
+    return nullptr;
+}
+
+/**
+ * Cut a loop into jobs and deal them out to the deques of the workers allowed to run them.
+ * A loop of one job goes to the next worker in turn rather than the caller's own deque: box2d starts its solver
+ * as one single-item task per worker, and those only help each other if they run at the same time.
+ * A job that does not fit in a full deque is run right away by the calling thread.
+ */
+static void SubmitJobs(JobGroup* group, JobFcn* fcn, void* context, int itemCount, int minRange, int workerLimit) {
+    int workers = workerLimit < workerCount ? workerLimit : workerCount;
+    int jobCount = itemCount / minRange;
+    if (jobCount > workers * JOB_SPLIT_PER_WORKER)
+        jobCount = workers * JOB_SPLIT_PER_WORKER;
+    if (jobCount < 1)
+        jobCount = 1;
+    atomic_store(&group->pending, jobCount);
+
+    uint32_t first = currentWorker < (uint32_t)workers ? currentWorker : 0;
+    if (jobCount == 1)
+        first = atomic_fetch_add_explicit(&nextSingleQueue, 1, memory_order_relaxed) % (uint32_t)workers;
+    for (int i = 0; i < jobCount; i++) {
+        Job job = {
+            .fcn = fcn,
+            .context = context,
+            .startIndex = (int)((int64_t)itemCount * i / jobCount),
+            .endIndex = (int)((int64_t)itemCount * (i + 1) / jobCount),
+            .workerLimit = workerLimit,
+            .group = group,
+        };
+        atomic_fetch_add_explicit(&queuedJobs, 1, memory_order_release);
+        if (!PushJob(&queues[(first + i) % workers], &job)) {
+            atomic_fetch_sub_explicit(&queuedJobs, 1, memory_order_relaxed);
+            fcn(job.startIndex, job.endIndex, currentWorker, context);
+            atomic_fetch_sub(&group->pending, 1);
+        }
+    }
+
+    pthread_mutex_lock(&sleepLock);
+    pthread_cond_broadcast(&wakeUp);
+    pthread_mutex_unlock(&sleepLock);
+}
+
+// Rather than block, the waiting thread runs jobs itself until the group is done
+static void WaitForGroup(JobGroup* group) {
+    while (atomic_load_explicit(&group->pending, memory_order_acquire) > 0)
+        RunOneJob(currentWorker);
+}
+
+static JobGroup* AcquireWorldGroup(void) {
+    for (int i = 0; i < JOB_MAX_GROUPS; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&worldGroups[i].inUse, &expected, true))
+            return &worldGroups[i];
+    }
+    return nullptr;
+}
+
+/**
+ * b2EnqueueTaskCallback. box2d runs the task itself when this returns null.
+ * Tasks too small to split are still queued, as a single job: the solver's per-worker tasks are exactly that,
+ * and running them inline would run the whole solver on the stepping thread.
+ * @param userContext How many workers the world was created with
+ */
+static void* EnqueueWorldTask(b2TaskCallback* task, int itemCount, int minRange, void* taskContext, void* userContext) {
+    int workerLimit = (int)(intptr_t)userContext;
+    if (workerLimit <= 1 || workerCount <= 1 || currentWorker >= (uint32_t)workerLimit) {
+        task(0, itemCount, currentWorker < (uint32_t)workerLimit ? currentWorker : 0, taskContext);
+        return nullptr;
+    }
+    JobGroup* group = AcquireWorldGroup();
+    if (group == nullptr) {
+        task(0, itemCount, currentWorker, taskContext);
+        return nullptr;
+    }
+    SubmitJobs(group, task, taskContext, itemCount, minRange < 1 ? 1 : minRange, workerLimit);
+    return group;
+}
+
+static void FinishWorldTask(void* userTask, void* userContext) {
+    JobGroup* group = userTask;
+    WaitForGroup(group);
+    atomic_store(&group->inUse, false);
+}
+#endif
+
+/**
+ * Start the worker threads. The calling thread becomes worker 0 and takes part in every loop it starts.
+ * @param count How many workers to run, including the calling thread. 0 or less means one per core.
+ * Builds without threads always run a single worker.
+ */
+void JobsInit(int count) {
+    currentWorker = 0;
+#ifdef JOBS_NO_THREAD
+    workerCount = 1;
+#else
+    if (count <= 0)
+        count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1)
+        count = 1;
+    if (count > JOB_MAX_WORKERS)
+        count = JOB_MAX_WORKERS;
+
+    static bool queuesReady = false;
+    if (!queuesReady) {
+        for (int i = 0; i < JOB_MAX_WORKERS; i++)
+            pthread_mutex_init(&queues[i].lock, nullptr);
+        queuesReady = true;
+    }
+    atomic_store(&queuedJobs, 0);
+    atomic_store(&running, true);
+    workerCount = 1;
+    for (int i = 1; i < count; i++) {
+        if (pthread_create(&threads[i], nullptr, WorkerMain, (void*)(uintptr_t)i) != 0)
+            break;
+        workerCount++;
+    }
+#endif
+    GAME_LOG(SEVERITY_INFO, LOGCAT_GENERAL, "Running jobs on %d worker%s", workerCount, workerCount == 1 ? "" : "s");
+}
+
+/**
+ * Stop the worker threads. Nothing may be running on them.
+ */
+void JobsShutdown(void) {
+#ifndef JOBS_NO_THREAD
+    pthread_mutex_lock(&sleepLock);
+    atomic_store(&running, false);
+    pthread_cond_broadcast(&wakeUp);
+    pthread_mutex_unlock(&sleepLock);
+    for (int i = 1; i < workerCount; i++)
+        pthread_join(threads[i], nullptr);
+#endif
+    workerCount = 1;
+}
+
+/**
+ * Restart the pool with a different number of workers. Call between steps, with no loop running.
+ * Worlds created before keep the worker count they were created with, see JobsConfigureWorld.
+ */
+void JobsSetWorkerCount(int count) {
+    JobsShutdown();
+    JobsInit(count);
+}
+
+int JobsWorkerCount(void) {
+    return workerCount;
+}
+
+/**
+ * Run fcn over itemCount items, split across the workers, and return once every item is done.
+ * Small loops, single worker builds, calls from threads outside the pool and loops started from inside a job
+ * run on the calling thread. The pool is already busy in the last case, and a thread waiting on a nested loop
+ * could otherwise pick up one of its siblings and sit on it.
+ * @param minRange The fewest items worth handing to another thread
+ */
+void ParallelFor(int itemCount, int minRange, JobFcn* fcn, void* context) {
+    if (itemCount <= 0)
+        return;
+    if (minRange < 1)
+        minRange = 1;
+#ifndef JOBS_NO_THREAD
+    if (workerCount > 1 && itemCount > minRange && currentWorker != JOB_NOT_A_WORKER && jobDepth == 0) {
+        JobGroup group;
+        atomic_init(&group.pending, 0);
+        atomic_init(&group.inUse, true);
+        SubmitJobs(&group, fcn, context, itemCount, minRange, workerCount);
+        WaitForGroup(&group);
+        return;
+    }
+#endif
+    fcn(0, itemCount, currentWorker == JOB_NOT_A_WORKER ? 0 : currentWorker, context);
+}
+
+/**
+ * Have a world run its solver on the job system. Step the world from the thread that called JobsInit.
+ * The world keeps the current worker count for life, so its tasks never reach workers it has no scratch for.
+ */
+void JobsConfigureWorld(b2WorldDef* worldDef) {
+#ifndef JOBS_NO_THREAD
+    if (workerCount <= 1)
+        return;
+    worldDef->workerCount = workerCount;
+    worldDef->enqueueTask = EnqueueWorldTask;
+    worldDef->finishTask = FinishWorldTask;
+    worldDef->userTaskContext = (void*)(intptr_t)workerCount;
+#endif
+}
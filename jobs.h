@@ -0,0 +1,27 @@
+//
+// Created by frick on 2025-07-27.
+//
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "box2d/types.h"
+#include <stdint.h>
+
+constexpr int JOB_MAX_WORKERS = 16;
+
+/**
+ * One slice of a parallel loop: handle the items from startIndex up to, not including, endIndex.
+ * Has the same signature as b2TaskCallback, so box2d's tasks go through the same queues as the game's.
+ * @param workerIndex The thread running the slice, below JobsWorkerCount(). Use it to index per-thread scratch.
+ */
+typedef void JobFcn(int startIndex, int endIndex, uint32_t workerIndex, void* context);
+
+void JobsInit(int workerCount);
+void JobsShutdown(void);
+void JobsSetWorkerCount(int workerCount);
+int JobsWorkerCount(void);
+void ParallelFor(int itemCount, int minRange, JobFcn* fcn, void* context);
+void JobsConfigureWorld(b2WorldDef* worldDef);
+
+#endif //JOBS_H
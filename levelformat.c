@@ -0,0 +1,231 @@
+//
+// Created by frick on 2025-07-18.
+//
+
+#include "levelformat.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #define LEVEL_NO_MMAP
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+static void WriteU16(uint8_t* p, uint16_t value) {
+    p[0] = (uint8_t)(value & 0xFF);
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static void WriteU32(uint8_t* p, uint32_t value) {
+    WriteU16(p, (uint16_t)(value & 0xFFFF));
+    WriteU16(p + 2, (uint16_t)(value >> 16));
+}
+
+static uint16_t ReadU16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t ReadU32(const uint8_t* p) {
+    return (uint32_t)ReadU16(p) | ((uint32_t)ReadU16(p + 2) << 16);
+}
+
+/**
+ * Pick the tile the ball spawns on: the last target or spawn tile in reading order,
+ * which is how the tile loader has always placed it.
+ * @param spawnCol Receives the column, or -1 if the level has neither
+ * @param spawnRow Receives the row, or -1 if the level has neither
+ */
+void FindLevelSpawn(const uint8_t* tiles, int width, int height, int* spawnCol, int* spawnRow) {
+    *spawnCol = -1;
+    *spawnRow = -1;
+    for (int i = 0; i < width * height; i++) {
+        if (tiles[i] == TILE_TARGET || tiles[i] == TILE_SPAWN) {
+            *spawnCol = i % width;
+            *spawnRow = i / width;
+        }
+    }
+}
+
+/**
+ * Serialize a level into the .rbl format.
+ * @param tiles width * height tile codes, each below TileCodeCount
+ * @param out The buffer to write to
+ * @param capacity The size of the buffer. LEVEL_FILE_HEADER_SIZE + width * height always suffices.
+ * @return The number of bytes written, or 0 if the level is invalid or does not fit
+ */
+size_t EncodeLevel(const uint8_t* tiles, int width, int height, uint8_t* out, size_t capacity) {
+    if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF || capacity < LEVEL_FILE_HEADER_SIZE)
+        return 0;
+
+    int count = width * height;
+    int targets = 0, solids = 0;
+    size_t size = LEVEL_FILE_HEADER_SIZE;
+    for (int i = 0; i < count;) {
+        uint8_t code = tiles[i];
+        if (code >= TileCodeCount)
+            return 0;
+        int run = 1;
+        while (i + run < count && run < LEVEL_MAX_RUN && tiles[i + run] == code)
+            run++;
+        if (size >= capacity)
+            return 0;
+        out[size++] = (uint8_t)(((run - 1) << 2) | code);
+        if (code == TILE_TARGET)
+            targets += run;
+        else if (code == TILE_SOLID)
+            solids += run;
+        i += run;
+    }
+
+    int spawnCol, spawnRow;
+    FindLevelSpawn(tiles, width, height, &spawnCol, &spawnRow);
+
+    memcpy(out, "RBBL", 4);
+    WriteU16(out + 4, LEVEL_FILE_VERSION);
+    WriteU16(out + 6, 0);
+    WriteU16(out + 8, (uint16_t)width);
+    WriteU16(out + 10, (uint16_t)height);
+    WriteU16(out + 12, (uint16_t)spawnCol);
+    WriteU16(out + 14, (uint16_t)spawnRow);
+    WriteU16(out + 16, (uint16_t)targets);
+    WriteU16(out + 18, (uint16_t)solids);
+    WriteU32(out + 20, (uint32_t)(size - LEVEL_FILE_HEADER_SIZE));
+    return size;
+}
+
+/**
+ * Parse an .rbl file straight from memory. Only the tiles are copied out.
+ * @param bytes The file's contents
+ * @param size The file's size
+ * @param out Receives the level. Free it with UnloadLevelData.
+ * @return False if the file is not a valid level of a version we can read
+ */
+bool DecodeLevel(const uint8_t* bytes, size_t size, LevelData* out) {
+    memset(out, 0, sizeof *out);
+    if (size < LEVEL_FILE_HEADER_SIZE || memcmp(bytes, "RBBL", 4) != 0)
+        return false;
+    if (ReadU16(bytes + 4) != LEVEL_FILE_VERSION)
+        return false;
+
+    int width = ReadU16(bytes + 8);
+    int height = ReadU16(bytes + 10);
+    uint16_t spawnCol = ReadU16(bytes + 12);
+    uint16_t spawnRow = ReadU16(bytes + 14);
+    uint32_t payloadSize = ReadU32(bytes + 20);
+    if (width == 0 || height == 0 || payloadSize > size - LEVEL_FILE_HEADER_SIZE)
+        return false;
+
+    // Both are up to 65535, so the product is taken in size_t. The rest of the game indexes tiles with int.
+    size_t count = (size_t)width * (size_t)height;
+    if (count > INT_MAX)
+        return false;
+    uint8_t* tiles = malloc(count);
+    if (tiles == nullptr)
+        return false;
+
+    const uint8_t* payload = bytes + LEVEL_FILE_HEADER_SIZE;
+    size_t filled = 0;
+    for (uint32_t i = 0; i < payloadSize; i++) {
+        size_t run = (payload[i] >> 2) + 1;
+        if (filled + run > count) {
+            free(tiles);
+            return false;
+        }
+        memset(tiles + filled, payload[i] & 0x3, run);
+        filled += run;
+    }
+    if (filled != count) {
+        free(tiles);
+        return false;
+    }
+
+    out->width = width;
+    out->height = height;
+    out->spawnCol = spawnCol == 0xFFFF ? -1 : spawnCol;
+    out->spawnRow = spawnRow == 0xFFFF ? -1 : spawnRow;
+    out->targetCount = ReadU16(bytes + 16);
+    out->solidCount = ReadU16(bytes + 18);
+    out->tiles = tiles;
+    return true;
+}
+
+/**
+ * Map a whole file into memory, read-only. Falls back to reading it into the heap where mmap is unavailable.
+ * @param path The file to map
+ * @param size Receives the file's size
+ * @return The file's contents, to be released with UnmapFile, or nullptr on failure
+ */
+const uint8_t* MapFile(const char* path, size_t* size) {
+    *size = 0;
+#if defined(LEVEL_NO_MMAP)
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr)
+        return nullptr;
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* buffer = length > 0 ? malloc((size_t)length) : nullptr;
+    if (buffer != nullptr && fread(buffer, 1, (size_t)length, file) != (size_t)length) {
+        free(buffer);
+        buffer = nullptr;
+    }
+    fclose(file);
+    if (buffer != nullptr)
+        *size = (size_t)length;
+    return buffer;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return nullptr;
+    *size = (size_t)info.st_size;
+    return mapped;
+#endif
+}
+
+void UnmapFile(const uint8_t* bytes, size_t size) {
+    if (bytes == nullptr)
+        return;
+#if defined(LEVEL_NO_MMAP)
+    free((void*)bytes);
+#else
+    munmap((void*)bytes, size);
+#endif
+}
+
+/**
+ * Load a compiled level from disk. The file is mapped rather than read, and decoded in place.
+ * @param path The .rbl file
+ * @param out Receives the level. Free it with UnloadLevelData.
+ * @return False if the file could not be read or is not a valid level
+ */
+bool LoadLevelData(const char* path, LevelData* out) {
+    memset(out, 0, sizeof *out);
+    size_t size;
+    const uint8_t* bytes = MapFile(path, &size);
+    if (bytes == nullptr)
+        return false;
+    bool ok = DecodeLevel(bytes, size, out);
+    UnmapFile(bytes, size);
+    return ok;
+}
+
+void UnloadLevelData(LevelData* data) {
+    free(data->tiles);
+    data->tiles = nullptr;
+}
@@ -0,0 +1,61 @@
+//
+// Created by frick on 2025-07-18.
+//
+
+#ifndef LEVELFORMAT_H
+#define LEVELFORMAT_H
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Compiled level files (.rbl), produced from Tiled maps by the levelc tool.
+ *
+ * All values are little-endian.
+ *   offset  size  field
+ *        0     4  magic "RBBL"
+ *        4     2  version (LEVEL_FILE_VERSION)
+ *        6     2  flags (reserved, 0)
+ *        8     2  width in tiles
+ *       10     2  height in tiles
+ *       12     2  ball spawn column (0xFFFF if none)
+ *       14     2  ball spawn row (0xFFFF if none)
+ *       16     2  target count
+ *       18     2  solid tile count
+ *       20     4  payload size in bytes
+ *       24     -  payload
+ *
+ * The payload is the tiles in reading order, run-length encoded: every byte holds a tile code
+ * in its low 2 bits and the run length minus one in its high 6 bits.
+ */
+
+constexpr uint16_t LEVEL_FILE_VERSION = 1;
+constexpr int LEVEL_FILE_HEADER_SIZE = 24;
+constexpr int LEVEL_MAX_RUN = 64;
+
+enum TileCodes {
+    TILE_EMPTY = 0,
+    TILE_SOLID = 1,
+    TILE_TARGET = 2,
+    TILE_SPAWN = 3,
+    TileCodeCount
+};
+
+typedef struct LevelData {
+    int width;
+    int height;
+    int spawnCol;
+    int spawnRow;
+    int targetCount;
+    int solidCount;
+    uint8_t* tiles;
+} LevelData;
+
+void FindLevelSpawn(const uint8_t* tiles, int width, int height, int* spawnCol, int* spawnRow);
+size_t EncodeLevel(const uint8_t* tiles, int width, int height, uint8_t* out, size_t capacity);
+bool DecodeLevel(const uint8_t* bytes, size_t size, LevelData* out);
+const uint8_t* MapFile(const char* path, size_t* size);
+void UnmapFile(const uint8_t* bytes, size_t size);
+bool LoadLevelData(const char* path, LevelData* out);
+void UnloadLevelData(LevelData* data);
+
+#endif //LEVELFORMAT_H
@@ -4,62 +4,300 @@
 
 #include "levels.h"
 #include <contact.h>
+#include <stdlib.h>
 #include <string.h>
+#include <box2d/box2d.h>
 #include "assets.h"
+#include "dispatch.h"
+#include "memarena.h"
+#include "sprites.h"
+#include "tiled.h"
 
 extern Texture TextureLibrary[TextureEnumSize];
 extern Sound SoundLibrary[SoundEnumSize];
 
-// TODO: Gör majoriteten av paddle-området till en killzone (optional för vissa banor)
-// Eventuellt kan du göra det med en killzone som har en float height som kan specificeras vid loadlevel.
-Level LoadLevel(int* levelData, Vector2 origin, b2WorldId world) {
-    Level level = { 0 };
-    level.targetCount = 0;
-    Target targets[128] = { 0 };
-    level.entityCount = 0;
-    Entity entities[128] = { 0 };
-
-
-    for (int i = 0; i < LEVELSIZE; i++) {
-        float yPos = origin.y + (i / LEVELWIDTH) * TILESIZE;
-        float xPos = origin.x + TILESIZE + (i % LEVELWIDTH) * TILESIZE;
-        b2Vec2 pos = {xPos, yPos};
-        int* currentID = levelData + i;
-        switch (*currentID) {
-            case 0:
+typedef struct TileRect {
+    int col;
+    int row;
+    int width;
+    int height;
+} TileRect;
+
+/**
+ * Cover every solid tile with as few axis-aligned rectangles as possible, greedily:
+ * each uncovered solid tile (in reading order) grows right as far as it can, then down
+ * for as long as the whole span below it is solid and uncovered.
+ * @param levelData The level's tiles
+ * @param rects Receives the rectangles, in tiles. Must hold one entry per solid tile.
+ * @param covered Scratch space for one flag per tile
+ * @return The number of rectangles
+ */
+static int MergeSolidTiles(const LevelData* levelData, TileRect* rects, bool* covered) {
+    int levelWidth = levelData->width;
+    int levelHeight = levelData->height;
+    const uint8_t* tiles = levelData->tiles;
+    int count = 0;
+    for (int row = 0; row < levelHeight; row++) {
+        for (int col = 0; col < levelWidth; col++) {
+            int i = row * levelWidth + col;
+            if (tiles[i] != TILE_SOLID || covered[i])
+                continue;
+
+            int width = 1;
+            while (col + width < levelWidth && tiles[i + width] == TILE_SOLID && !covered[i + width])
+                width++;
+
+            int height = 1;
+            while (row + height < levelHeight) {
+                int rowStart = (row + height) * levelWidth + col;
+                bool solid = true;
+                for (int k = 0; k < width && solid; k++)
+                    solid = tiles[rowStart + k] == TILE_SOLID && !covered[rowStart + k];
+                if (!solid)
+                    break;
+                height++;
+            }
+
+            for (int r = row; r < row + height; r++)
+                for (int c = col; c < col + width; c++)
+                    covered[r * levelWidth + c] = true;
+            rects[count++] = (TileRect){col, row, width, height};
+        }
+    }
+    return count;
+}
+
+/**
+ * Creates the level's solid blocks as a single static body, with one box per merged rectangle of tiles.
+ * @param bodyId The body of a previous level, whose shapes are replaced, or b2_nullBodyId to create one
+ * @param solidCount The number of solid tiles
+ * @param scratch Temporary space for merging, given back before returning
+ * @return The static body holding every solid block
+ */
+static b2BodyId CreateLevelSolids(b2BodyId bodyId, const LevelData* levelData, int solidCount, Vector2 origin, b2WorldId world, MemArena* scratch) {
+    size_t mark = scratch->used;
+    TileRect* rects = MEMARENA_ALLOC(scratch, TileRect, solidCount);
+    bool* covered = MEMARENA_ALLOC(scratch, bool, levelData->width * levelData->height);
+    int rectCount = MergeSolidTiles(levelData, rects, covered);
+
+    if (B2_IS_NULL(bodyId)) {
+        b2BodyDef bodyDef = b2DefaultBodyDef();
+        bodyDef.type = b2_staticBody;
+        bodyId = b2CreateBody(world, &bodyDef);
+    }
+    else {
+        b2ShapeId shapeId;
+        while (b2Body_GetShapes(bodyId, &shapeId, 1) == 1)
+            b2DestroyShape(shapeId, false);
+    }
+
+    b2ShapeDef shapeDef = b2DefaultShapeDef();
+    shapeDef.filter.categoryBits = GROUND;
+    shapeDef.material.friction = 0.0f;
+
+    b2Vec2 blockExtent = {
+        TextureLibrary[t_block_idle].width * 0.5f,
+        TextureLibrary[t_block_idle].height * 0.5f
+    };
+    for (int i = 0; i < rectCount; i++) {
+        TileRect rect = rects[i];
+        // Tile centers are laid out exactly like LoadLevel places single tiles
+        b2Vec2 center = {
+            origin.x + TILESIZE + (rect.col + (rect.width - 1) * 0.5f) * TILESIZE,
+            origin.y + (rect.row + (rect.height - 1) * 0.5f) * TILESIZE
+        };
+        b2Polygon box = b2MakeOffsetBox(
+            (rect.width - 1) * TILESIZE * 0.5f + blockExtent.x,
+            (rect.height - 1) * TILESIZE * 0.5f + blockExtent.y,
+            center,
+            b2Rot_identity);
+        shapeDef.userData = MakeShapeHandle(SHAPE_SOLID, i);
+        b2CreatePolygonShape(bodyId, &shapeDef, &box);
+    }
+    MemArenaRewind(scratch, mark);
+    return bodyId;
+}
+
+static b2Vec2 TileCenter(Vector2 origin, int col, int row) {
+    return (b2Vec2){
+        origin.x + TILESIZE + col * TILESIZE,
+        origin.y + row * TILESIZE
+    };
+}
+
+/**
+ * Load a level's tiles from a Tiled map (.tmj) or a compiled level (.rbl), by extension.
+ * @param path The level file
+ * @param out Receives the tiles. Free them with UnloadLevelData.
+ * @return False if the file could not be loaded
+ */
+bool LoadLevelFile(const char* path, LevelData* out) {
+    if (IsFileExtension(path, ".tmj"))
+        return LoadTiledLevel(path, out);
+    return LoadLevelData(path, out);
+}
+
+/**
+ * Lay a level out over the bodies the Level already has, creating only the targets it is short of.
+ * Switching to another level moves the level's data to a new arena sized for it, carrying the target bodies over;
+ * restarting the same level touches no memory and leaves the solid geometry alone.
+ * @return False if the new level's memory could not be allocated, in which case the old one is kept
+ */
+static bool LayOutLevel(Level* level, const LevelData* levelData) {
+    int tileCount = levelData->width * levelData->height;
+    int targetCount = 0, solidCount = 0;
+    for (int i = 0; i < tileCount; i++) {
+        targetCount += levelData->tiles[i] == TILE_TARGET;
+        solidCount += levelData->tiles[i] == TILE_SOLID;
+    }
+
+    bool switching = levelData != level->data;
+    if (switching) {
+        int capacity = targetCount > level->targetCapacity ? targetCount : level->targetCapacity;
+        // The merge scratch space is carved from the same block, past the level's own data, and given back
+        size_t size = MEMARENA_SIZE(Target, capacity) + 2 * MEMARENA_SIZE(int, capacity) + MEMARENA_SIZE(Vector2, solidCount)
+            + MEMARENA_SIZE(TileRect, solidCount) + MEMARENA_SIZE(bool, tileCount);
+        MemArena arena;
+        if (!MemArenaInit(&arena, size))
+            return false;
+        Target* targets = MEMARENA_ALLOC(&arena, Target, capacity);
+        if (level->targetCapacity > 0)
+            memcpy(targets, level->targets, level->targetCapacity * sizeof *targets);
+        level->liveTargets = MEMARENA_ALLOC(&arena, int, capacity);
+        level->liveIndex = MEMARENA_ALLOC(&arena, int, capacity);
+        level->blocks = MEMARENA_ALLOC(&arena, Vector2, solidCount);
+        MemArenaFree(&level->arena);
+        level->arena = arena;
+        level->targets = targets;
+    }
+
+    b2Vec2 blockExtent = {
+        TextureLibrary[t_block_idle].width * 0.5f,
+        TextureLibrary[t_block_idle].height * 0.5f
+    };
+
+    level->targetCount = 0;
+    level->liveCount = 0;
+    level->blockCount = 0;
+    for (int i = 0; i < tileCount; i++) {
+        b2Vec2 pos = TileCenter(level->origin, i % levelData->width, i / levelData->width);
+        switch (levelData->tiles[i]) {
+            case TILE_SOLID:
+                // Solid blocks only need drawing here, their collision is merged below
+                level->blocks[level->blockCount++] = (Vector2){pos.x - blockExtent.x, pos.y - blockExtent.y};
+                break;
+            case TILE_TARGET: {
+                int index = level->targetCount++;
+                if (index < level->targetCapacity)
+                    ResetTarget(level->targets + index, pos);
+                else
+                    level->targets[index] = CreateTarget(
+                        pos, 
+                        1.0f, 
+                        WHITE, 
+                        index,
+                        level->worldId);
+                level->liveIndex[index] = level->liveCount;
+                level->liveTargets[level->liveCount++] = index;
                 break;
-            case 1:
-                entities[level.entityCount++] = CreateSolid(
-                    pos, 
-                    (b2Vec2){
-                        TextureLibrary[t_block_idle].width * 0.5f, 
-                        TextureLibrary[t_block_idle].height * 0.5f 
-                    }, 
-                    &TextureLibrary[t_block_idle], 
-                    WHITE, 
-                    world);
+            }
+            default:
                 break;
-            case 2:
-                targets[level.targetCount++] = CreateTarget(
-                    pos, 
-                    1.0f, 
-                    WHITE, 
-                    world);
-            case 3:
-                level.ballSpawn = pos;
         }
     }
-    memcpy(level.targets, targets, sizeof(Target) * level.targetCount);
-    memcpy(level.entities, entities, sizeof(Entity) * level.entityCount);
-    return level;
+    // Bodies left over from a level with more targets wait, disabled, for the next one that needs them
+    for (int i = level->targetCount; i < level->targetCapacity; i++)
+        b2Body_Disable(level->targets[i].bodyId);
+    if (level->targetCount > level->targetCapacity)
+        level->targetCapacity = level->targetCount;
+
+    level->ballSpawn = b2Vec2_zero;
+    if (levelData->spawnCol >= 0)
+        level->ballSpawn = TileCenter(level->origin, levelData->spawnCol, levelData->spawnRow);
+
+    if (switching)
+        level->solidBody = CreateLevelSolids(level->solidBody, levelData, solidCount, level->origin, level->worldId, &level->arena);
+    level->data = levelData;
+    // Everything static is now in place, so build the static tree once instead of letting it be refit per body
+    b2World_RebuildStaticTree(level->worldId);
+    return true;
 }
 
-void DrawLevel(Level* level) {
+// TODO: Gör majoriteten av paddle-området till en killzone (optional för vissa banor)
+// Eventuellt kan du göra det med en killzone som har en float height som kan specificeras vid loadlevel.
+/**
+ * Build a level's bodies in the world. Its targets and blocks live in one arena sized exactly
+ * for the level, so there is no cap on their number and UnloadLevel frees them in one go.
+ * @param level Receives the level
+ * @param levelData The level's tiles
+ * @param origin Top left corner of the playing field
+ * @param world The world to create the level's bodies in
+ * @return False if the level's memory could not be allocated
+ */
+bool LoadLevel(Level* level, const LevelData* levelData, Vector2 origin, b2WorldId world) {
+    memset(level, 0, sizeof *level);
+    level->origin = origin;
+    level->worldId = world;
+    level->solidBody = b2_nullBodyId;
+    return LayOutLevel(level, levelData);
+}
+
+/**
+ * Start a level over, or switch to another one, in the world the Level was loaded into, without creating or
+ * destroying bodies where it can be helped. Every target comes back unbroken, reusing the bodies of the
+ * previous layout; only a switch to a level with more targets creates new ones, and only a switch rebuilds
+ * the solid blocks' shapes, on the same body.
+ * @param levelData The level to lay out. Levels are told apart by address, so passing the one already loaded
+ *                  restarts it.
+ * @return False if a new level's memory could not be allocated, in which case the old one is restarted instead
+ */
+bool ResetLevel(Level* level, const LevelData* levelData) {
+    if (LayOutLevel(level, levelData))
+        return true;
+    if (level->data != nullptr)
+        LayOutLevel(level, level->data);
+    return false;
+}
+
+/**
+ * Take a broken target out of the world and out of the per-frame work. Its body is disabled and kept
+ * for the next reset. Breaking a target twice does nothing.
+ */
+void BreakTarget(Level* level, int index) {
+    if (index < 0 || index >= level->targetCount)
+        return;
+    int live = level->liveIndex[index];
+    if (live < 0)
+        return;
+    b2Body_Disable(level->targets[index].bodyId);
+
+    // Swap the last live target into the hole
+    int last = level->liveTargets[--level->liveCount];
+    level->liveTargets[live] = last;
+    level->liveIndex[last] = live;
+    level->liveIndex[index] = -1;
+}
 
-    for (int i = 0; i < level->targetCount; i++) {
-        DrawTarget(&(level->targets[i]));
+/**
+ * Free a level's memory. Its bodies belong to the world and go with it.
+ */
+void UnloadLevel(Level* level) {
+    MemArenaFree(&level->arena);
+    memset(level, 0, sizeof *level);
+}
+
+/**
+ * Draw the level's targets. Its blocks never change and are drawn separately, see DrawLevelBlocks.
+ */
+void DrawLevel(Level* level) {
+    // Broken targets have left the list
+    for (int i = 0; i < level->liveCount; i++) {
+        DrawTarget(&(level->targets[level->liveTargets[i]]));
     }
-    for (int i = 0; i < level->entityCount; i++) {
-        DrawEntity(&(level->entities[i]));
+}
+
+void DrawLevelBlocks(const Level* level) {
+    for (int i = 0; i < level->blockCount; i++) {
+        DrawSprite(t_block_idle, level->blocks[i], 0, 1.0f, WHITE);
     }
 }
@@ -0,0 +1,233 @@
+//
+// Created by frick on 2025-07-25.
+//
+
+#include "logger.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(PLATFORM_WEB) || defined(__EMSCRIPTEN__)
+    #define LOG_NO_THREAD
+#else
+    #include <pthread.h>
+    #include <time.h>
+#endif
+
+/*
+ * Messages are formatted by the thread that logs them, straight into a slot of a fixed ring buffer,
+ * and written out by a background thread. Logging never blocks and never does I/O: a full ring drops
+ * the message and counts it instead. The ring is a bounded multi-producer queue in which every slot
+ * carries a sequence number, so producers only race on one atomic counter.
+ * Without threads (the web build) the ring is drained by LogPump, once per frame.
+ */
+
+constexpr int LOG_RING_SIZE = 1024;
+constexpr int LOG_LINE_SIZE = 240;
+
+typedef struct LogSlot {
+    atomic_size_t sequence;
+    uint8_t severity;
+    uint8_t category;
+    char text[LOG_LINE_SIZE];
+} LogSlot;
+
+static const char* SeverityNames[] = {
+    [SEVERITY_DEBUG] = "debug",
+    [SEVERITY_INFO] = "info",
+    [SEVERITY_WARNING] = "warning",
+    [SEVERITY_ERROR] = "error",
+    [SEVERITY_NONE] = "none",
+};
+
+static const char* CategoryNames[LogCategoryCount] = {
+    [LOGCAT_GENERAL] = "general",
+    [LOGCAT_CONTACTS] = "contacts",
+    [LOGCAT_PADDLE] = "paddle",
+    [LOGCAT_INPUT] = "input",
+    [LOGCAT_UI] = "ui",
+    [LOGCAT_LEVEL] = "level",
+};
+
+static LogSlot ring[LOG_RING_SIZE];
+static atomic_size_t writePosition = 0;
+static size_t readPosition = 0;
+static atomic_size_t droppedCount = 0;
+static atomic_int filters[LogCategoryCount];
+static bool initialized = false;
+
+#ifndef LOG_NO_THREAD
+static pthread_t writerThread;
+static atomic_bool writerRunning = false;
+#endif
+
+// Only ever called from one thread at a time: the writer thread, or LogPump/LogShutdown without one
+static bool DrainRing(void) {
+    bool wrote = false;
+    while (true) {
+        LogSlot* slot = ring + (readPosition % LOG_RING_SIZE);
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != readPosition + 1)
+            break;
+        FILE* stream = slot->severity >= SEVERITY_WARNING ? stderr : stdout;
+        fprintf(stream, "[%s][%s] %s\n", SeverityNames[slot->severity], CategoryNames[slot->category], slot->text);
+        atomic_store_explicit(&slot->sequence, readPosition + LOG_RING_SIZE, memory_order_release);
+        readPosition++;
+        wrote = true;
+    }
+    size_t dropped = atomic_exchange(&droppedCount, 0);
+    if (dropped > 0)
+        fprintf(stderr, "[warning][general] log ring full, %zu messages dropped\n", dropped);
+    if (wrote)
+        fflush(stdout);
+    return wrote;
+}
+
+#ifndef LOG_NO_THREAD
+static void* WriterMain(void* argument) {
+    struct timespec idle = {0, 2 * 1000 * 1000};
+    while (atomic_load(&writerRunning)) {
+        if (!DrainRing())
+            nanosleep(&idle, nullptr);
+    }
+    return nullptr;
+}
+#endif
+
+/**
+ * Set up the ring and start the writer thread. Until then, messages are printed directly.
+ */
+void LogInit(void) {
+    if (initialized)
+        return;
+    for (int i = 0; i < LOG_RING_SIZE; i++)
+        atomic_init(&ring[i].sequence, (size_t)i);
+    atomic_store(&writePosition, 0);
+    readPosition = 0;
+    for (int i = 0; i < LogCategoryCount; i++)
+        atomic_init(&filters[i], SEVERITY_DEBUG);
+    initialized = true;
+#ifndef LOG_NO_THREAD
+    atomic_store(&writerRunning, true);
+    if (pthread_create(&writerThread, nullptr, WriterMain, nullptr) != 0)
+        atomic_store(&writerRunning, false);
+#endif
+}
+
+/**
+ * Write out everything still queued and stop the writer thread.
+ */
+void LogShutdown(void) {
+    if (!initialized)
+        return;
+#ifndef LOG_NO_THREAD
+    if (atomic_exchange(&writerRunning, false))
+        pthread_join(writerThread, nullptr);
+#endif
+    DrainRing();
+    initialized = false;
+}
+
+/**
+ * Write out queued messages when there is no writer thread. Call once per frame.
+ */
+void LogPump(void) {
+#ifndef LOG_NO_THREAD
+    if (atomic_load(&writerRunning))
+        return;
+#endif
+    if (initialized)
+        DrainRing();
+}
+
+bool LogEnabled(int severity, int category) {
+    if (!initialized)
+        return severity >= SEVERITY_INFO;
+    return severity >= atomic_load_explicit(&filters[category], memory_order_relaxed);
+}
+
+void LogMessage(int severity, int category, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    if (!initialized) {
+        FILE* stream = severity >= SEVERITY_WARNING ? stderr : stdout;
+        fprintf(stream, "[%s][%s] ", SeverityNames[severity], CategoryNames[category]);
+        vfprintf(stream, format, args);
+        fputc('\n', stream);
+        va_end(args);
+        return;
+    }
+
+    size_t position = atomic_load_explicit(&writePosition, memory_order_relaxed);
+    LogSlot* slot;
+    while (true) {
+        slot = ring + (position % LOG_RING_SIZE);
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&writePosition, &position, position + 1,
+                memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0) {
+            // The writer is a whole ring behind
+            atomic_fetch_add_explicit(&droppedCount, 1, memory_order_relaxed);
+            va_end(args);
+            return;
+        }
+        else {
+            position = atomic_load_explicit(&writePosition, memory_order_relaxed);
+        }
+    }
+
+    slot->severity = (uint8_t)severity;
+    slot->category = (uint8_t)category;
+    vsnprintf(slot->text, sizeof slot->text, format, args);
+    va_end(args);
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+}
+
+/**
+ * Only log messages of at least a severity for a category. SEVERITY_NONE silences it.
+ */
+void LogSetFilter(int category, int minSeverity) {
+    atomic_store(&filters[category], minSeverity);
+}
+
+void LogSetFilters(int minSeverity) {
+    for (int i = 0; i < LogCategoryCount; i++)
+        LogSetFilter(i, minSeverity);
+}
+
+/**
+ * Apply a filter given as "category=severity", e.g. "contacts=debug" or "all=warning".
+ * @return False if the category or severity is unknown
+ */
+bool LogParseFilter(const char* spec) {
+    const char* equals = strchr(spec, '=');
+    if (equals == nullptr)
+        return false;
+    size_t nameLength = (size_t)(equals - spec);
+
+    int severity = -1;
+    for (int i = 0; i <= SEVERITY_NONE; i++) {
+        if (strcmp(equals + 1, SeverityNames[i]) == 0)
+            severity = i;
+    }
+    if (severity < 0)
+        return false;
+
+    if (nameLength == 3 && strncmp(spec, "all", 3) == 0) {
+        LogSetFilters(severity);
+        return true;
+    }
+    for (int i = 0; i < LogCategoryCount; i++) {
+        if (strlen(CategoryNames[i]) == nameLength && strncmp(spec, CategoryNames[i], nameLength) == 0) {
+            LogSetFilter(i, severity);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,54 @@
+//
+// Created by frick on 2025-07-25.
+//
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+enum LogSeverity {
+    SEVERITY_DEBUG,
+    SEVERITY_INFO,
+    SEVERITY_WARNING,
+    SEVERITY_ERROR,
+    SEVERITY_NONE,
+};
+
+enum LogCategory {
+    LOGCAT_GENERAL,
+    LOGCAT_CONTACTS,
+    LOGCAT_PADDLE,
+    LOGCAT_INPUT,
+    LOGCAT_UI,
+    LOGCAT_LEVEL,
+    LogCategoryCount
+};
+
+// Messages below this severity are compiled out entirely
+#ifndef LOG_MIN_SEVERITY
+    #ifdef NDEBUG
+        #define LOG_MIN_SEVERITY SEVERITY_INFO
+    #else
+        #define LOG_MIN_SEVERITY SEVERITY_DEBUG
+    #endif
+#endif
+
+/**
+ * Log a printf-style message. The arguments are not evaluated when the severity is compiled out
+ * or filtered out for the category at runtime.
+ */
+#define GAME_LOG(severity, category, ...) \
+    do { \
+        if ((severity) >= LOG_MIN_SEVERITY && LogEnabled((severity), (category))) \
+            LogMessage((severity), (category), __VA_ARGS__); \
+    } while (0)
+
+void LogInit(void);
+void LogShutdown(void);
+void LogPump(void);
+bool LogEnabled(int severity, int category);
+void LogMessage(int severity, int category, const char* format, ...);
+void LogSetFilter(int category, int minSeverity);
+void LogSetFilters(int minSeverity);
+bool LogParseFilter(const char* spec);
+
+#endif //LOGGER_H
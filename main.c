@@ -3,19 +3,32 @@
 #include "box2d/box2d.h"
 
 #include <assert.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #include "assets.h"
+#include "audio.h"
+#include "balls.h"
+#include "game.h"
+#include "input.h"
+#include "interpolation.h"
+#include "jobs.h"
 #include "rlgl.h"
 #include "entities.h"
 #include "arena.h"
 #include "interface.h"
 #include "levels.h"
+#include "logger.h"
+#include "profiler.h"
+#include "replay.h"
+#include "sprites.h"
+#include "trajectory.h"
 
 Texture TextureLibrary[TextureEnumSize] = { 0 };
+TextureAtlas textureAtlas = { 0 };
 Sound SoundLibrary[SoundEnumSize] = { nullptr };
 Font menuFont = { 0 };
 
@@ -23,35 +36,203 @@ Font menuFont = { 0 };
 	#include <emscripten/emscripten.h>
 #endif
 
-float InvLerp(float a, float b, float t) {
-	return (t - a) / (b - a);
-}
-
-void Update(void);
 void DrawFrame(void);
-void InitWorld(void);
+void LoadingFrame(void);
+GameConfig WorldConfig(bool presented);
 void UnloadAssets(void);
+int RunHeadless(int episodes, int ticks, float tickRate);
+int RunReplay(void);
+void StartRecording(uint64_t seed);
+void StopRecording(void);
+
+// After a hitch, at most this many ticks are simulated in one frame; the rest of the backlog is dropped
+#define MAX_TICKS_PER_FRAME 5
 
+int width = 1920, height = 1080;
+bool headless = false;
+bool verbose = false;
+float tickRate = 60.0f;
+float tickAccumulator = 0.0f;
+uint32_t pendingPresses = 0;
+const char* levelPath = "levels/rooms.rbl";
+LevelData levelData = { 0 };
+StaticLayer staticLayer = { 0 };
+HUD hud = { 0 };
+bool showProfiler = false;
+const char* profilePath = nullptr;
+int startingBalls = 1;
+int boxCount = BOX_COUNT;
+// Seeds the RNG of every world, and is stored in traces
+uint64_t worldSeed = 0;
+const char* recordPath = nullptr;
+const char* replayPath = nullptr;
+InputRecorder recorder = { 0 };
+InputReplay replay = { 0 };
+bool replaying = false;
+// The world on screen, or the one a replay runs
+GameContext game;
+// Whether the window is still showing the loading screen; the world is built once the assets are in
+bool loading = true;
+
+/**
+ * One rendered frame. The simulation advances in fixed ticks of 1/tickRate seconds, as many as fit
+ * in the time that has passed, and the frame is drawn interpolated between the last two ticks.
+ */
 void CoreLoop(void){
-	Update();
+	if (loading) {
+		LoadingFrame();
+		return;
+	}
+	ProfilerBeginFrame();
+	ProfileBegin(PROFILE_INPUT);
+	InputState input = PollInput();
+	ProfileEnd(PROFILE_INPUT);
+	if (input.pressed & INPUT_KEY_PROFILER)
+		showProfiler = !showProfiler;
+	if ((input.pressed & INPUT_KEY_PROFILER_DUMP) && WriteProfileCsv(profilePath != nullptr ? profilePath : "profile.csv"))
+		GAME_LOG(SEVERITY_INFO, LOGCAT_GENERAL, "Profile written to %s", profilePath != nullptr ? profilePath : "profile.csv");
+
+	if (replaying) {
+		// A replay runs one tick per frame, as fast as frames can be drawn, and ignores the live input
+		InputState recorded;
+		if (ReplayInput(&replay, &recorded)) {
+			Update(&game, &recorded, 1.0f / tickRate);
+		}
+		else {
+			GAME_LOG(SEVERITY_INFO, LOGCAT_GENERAL, "Replay of %s finished after %u ticks", replayPath, replay.tick);
+			replaying = false;
+			game.gameState.paused = true;
+		}
+		FlushSounds();
+		SetInterpolationAlpha(1.0f);
+		DrawFrame();
+		ProfilerEndFrame();
+		LogPump();
+		return;
+	}
+
+	// Presses must survive frames that run no tick, and must not repeat when a frame runs several
+	pendingPresses |= input.pressed;
+
+	float tickTime = 1.0f / tickRate;
+	tickAccumulator += GetFrameTime();
+	if (tickAccumulator > MAX_TICKS_PER_FRAME * tickTime)
+		tickAccumulator = MAX_TICKS_PER_FRAME * tickTime;
+
+	while (tickAccumulator >= tickTime) {
+		input.pressed = pendingPresses;
+		pendingPresses = 0;
+		// Rounds the mouse position to what the trace stores, so the replay matches exactly
+		RecordInput(&recorder, &input);
+		Update(&game, &input, tickTime);
+		tickAccumulator -= tickTime;
+	}
+	// The hits of every tick this frame, merged per effect
+	FlushSounds();
+
+	SetInterpolationAlpha(game.gameState.paused ? 1.0f : tickAccumulator / tickTime);
 	DrawFrame();
+	ProfilerEndFrame();
+	LogPump();
 }
 
-#define BOX_COUNT 10
-
-int width = 1920, height = 1080;
-int main(void)
+int main(int argc, char** argv)
 {
-	srand(time(nullptr));
+	LogInit();
+
+	int episodes = 100, ticks = 3600;
+	int workers = 0;
+	bool forceVerbose = false;
+	bool seeded = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--headless") == 0)
+			headless = true;
+		else if (strcmp(argv[i], "--verbose") == 0)
+			forceVerbose = true;
+		else if (strcmp(argv[i], "--episodes") == 0 && i + 1 < argc)
+			episodes = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+			ticks = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--hz") == 0 && i + 1 < argc)
+			tickRate = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc)
+			levelPath = argv[++i];
+		else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+			profilePath = argv[++i];
+		else if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc)
+			startingBalls = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--boxes") == 0 && i + 1 < argc)
+			boxCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			worldSeed = strtoull(argv[++i], nullptr, 10);
+			seeded = true;
+		}
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			recordPath = argv[++i];
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+			replayPath = argv[++i];
+		else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+			workers = atoi(argv[++i]);
+	}
+
+	if (!seeded)
+		worldSeed = (uint64_t)time(nullptr);
+	// A trace carries everything needed to rebuild the world it was recorded in
+	if (replayPath != nullptr) {
+		if (!OpenReplay(&replay, replayPath)) {
+			GAME_LOG(SEVERITY_ERROR, LOGCAT_GENERAL, "Could not read trace %s", replayPath);
+			LogShutdown();
+			return 1;
+		}
+		replaying = true;
+		recordPath = nullptr;
+		worldSeed = replay.header.seed;
+		tickRate = replay.header.tickRate;
+		startingBalls = replay.header.startingBalls;
+		boxCount = replay.header.boxCount != 0 ? replay.header.boxCount : BOX_COUNT;
+		levelPath = replay.header.levelPath;
+	}
+
+	// Levels are decoded once and rebuilt from memory whenever the world is
+	if (!LoadLevelFile(levelPath, &levelData)) {
+		GAME_LOG(SEVERITY_ERROR, LOGCAT_LEVEL, "Could not load level %s", levelPath);
+		CloseReplay(&replay);
+		LogShutdown();
+		return 1;
+	}
+
+	// Per-event debug output would dominate a headless run, so it is opt-in there
+	verbose = !headless || forceVerbose;
+	LogSetFilters(verbose ? SEVERITY_DEBUG : SEVERITY_INFO);
+	// --log category=severity overrides the default, e.g. --log contacts=none
+	for (int i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "--log") == 0 && !LogParseFilter(argv[++i]))
+			GAME_LOG(SEVERITY_WARNING, LOGCAT_GENERAL, "Unknown log filter %s", argv[i]);
+	}
+	// box2d's solver and the per-tick ball work are spread over these
+	JobsInit(workers);
+	b2SetLengthUnitsPerMeter(LENGTH_UNITS_PER_METER);
+
+	if (headless) {
+		// No window, no audio device and no GPU: only the texture sizes are needed to lay out the world.
+		SetTraceLogLevel(LOG_WARNING);
+		LoadAssetMetrics();
+		int result = replaying ? RunReplay() : RunHeadless(episodes, ticks, tickRate);
+		CloseReplay(&replay);
+		UnloadLevelData(&levelData);
+		JobsShutdown();
+		LogShutdown();
+		return result;
+	}
+
 	InitWindow(width, height, "box2d-raylib");
 	InitAudioDevice();
-	LoadAssetLibraries();
-	menuFont = LoadFont("assets/UI/Kenney Future Narrow.ttf");
-	InitWorld();
+	// Assets load over the first frames, behind a loading screen; see LoadingFrame
 	#if defined(PLATFORM_WEB)
 		emscripten_set_main_loop(CoreLoop, 0, 1);
 	#else
-		SetTargetFPS(60);   // Set our game to run at 60 frames-per-second
+		// Replays run uncapped
+		SetTargetFPS(replaying ? 0 : 60);   // Set our game to run at 60 frames-per-second
 	//--------------------------------------------------------------------------------------
 
 		// Main game loop
@@ -61,515 +242,339 @@ int main(void)
 		}
 	#endif
 
+	if (profilePath != nullptr && !WriteProfileCsv(profilePath))
+		GAME_LOG(SEVERITY_ERROR, LOGCAT_GENERAL, "Could not write profile %s", profilePath);
+	StopRecording();
+	CloseReplay(&replay);
+	// Closing the window while loading leaves no world to destroy
+	if (!loading)
+		DestroyWorld(&game);
+	UnloadStaticLayer(&staticLayer);
+	UnloadHUD(&hud);
+	UnloadVoices();
 	UnloadAssetLibraries();
+	UnloadLevelData(&levelData);
 
 	CloseAudioDevice();
 	CloseWindow();
+	JobsShutdown();
+	LogShutdown();
 
 	return 0;
 }
 
 constexpr bool DEBUG = true;
 
-float lengthUnitsPerMeter;
-b2WorldId worldId;
-Level level;
-Camera2D camera = { 0 };
-Vector2 screenOrigin, screenMax;
-Rectangle screenBounds;
-
-GameState gameState = {
-	.paused = false,
-	.state = GAME_ACTIVE,
-	.score = 0
-};
-
-PauseMenu* pauseMenu;
-
-Entity boxEntities[BOX_COUNT] = { 0 };
-Entity leftWall, rightWall, ceiling, limit, deathZone;
-Ball ballEntity;
-Paddle paddle;
-
-Vector2 mousePosition;
-Vector2 mouseDelta;
-
-Vector2 mouseInWorld;
-b2Vec2 mVec;
-b2Vec2 paddleTarget;
-
-bool holdingEntity = false;
-Entity* lastHeldEntity;
-
-BallRayCastContext context = {0};
-b2Vec2 origin = { 0 };
-b2Vec2 translation = { 0 };
-b2Vec2 VectorsToDraw[10] = { 0 };
-
-void InitWorld(void) {
-	camera.target = (Vector2){ width/2.0f, height/2.0f };
-	camera.offset = (Vector2){ width/2.0f, height/2.0f };
-	camera.rotation = 0.0f;
-	camera.zoom = 0.5f;
-
-	// 128 pixels per meter is a appropriate for this scene. The boxes are 128 pixels wide.
-	lengthUnitsPerMeter = 128.0f;
-	b2SetLengthUnitsPerMeter(lengthUnitsPerMeter);
-
-	b2WorldDef worldDef = b2DefaultWorldDef();
-
-	// Realistic gravity is achieved by multiplying gravity by the length unit.
-	worldDef.gravity.y = 9.8f * lengthUnitsPerMeter;
-	worldDef.enableSleep = false;
-	worldDef.hitEventThreshold = 2.0f * lengthUnitsPerMeter;
-	worldId = b2CreateWorld(&worldDef);
-
-
-	// Top-left and bottom-right vectors
-	screenOrigin = GetScreenToWorld2D((Vector2){0, 0}, camera);
-	screenMax = GetScreenToWorld2D((Vector2){width, height}, camera);
-	screenBounds = (Rectangle){screenOrigin.x, screenOrigin.y, screenMax.x - screenOrigin.x, screenMax.y - screenOrigin.y};
-
-	b2Vec2 staticsExtent = { 0.5f * TextureLibrary[t_block_idle].width, 0.5f * TextureLibrary[t_block_idle].height };
-
-	// Defining the solid walls
-	b2Vec2 wallExtent = {
-		TextureLibrary[t_wall_left].width * 0.5f,
-		(screenMax.y - screenOrigin.y) * 0.5f
-	};
-	b2Vec2 lPos = {
-		screenOrigin.x + staticsExtent.x,
-		screenOrigin.y + (screenMax.y - screenOrigin.y) * 0.5f
-	};
-	b2Vec2 rPos = {
-		screenMax.x - staticsExtent.x,
-		screenOrigin.y + (screenMax.y - screenOrigin.y) * 0.5f
+/**
+ * What every world of this run is built from.
+ * @param presented Whether the world is the one on screen
+ */
+GameConfig WorldConfig(bool presented) {
+	return (GameConfig){
+		.levelData = &levelData,
+		.levelPath = levelPath,
+		.seed = worldSeed,
+		.startingBalls = startingBalls,
+		.boxCount = boxCount,
+		.width = width,
+		.height = height,
+		.presented = presented,
+		// The player's retries are recorded in traces, so a replay, with a window or without, needs the snapshots too
+		.keepHistory = presented || replaying,
+		.parallelSolver = true,
 	};
-	leftWall = CreateSolid(lPos, wallExtent, nullptr, PURPLE, worldId);
-	rightWall = CreateSolid(rPos, wallExtent, nullptr, PURPLE, worldId);
+}
 
-	// Defining the solid ceiling
-	b2Vec2 ceilPos = {
-		screenOrigin.x + ((screenMax.x - screenOrigin.x) / 2),
-		screenOrigin.y + TextureLibrary[t_ceiling_left].height * 0.5f
-	};
-	b2Vec2 ceilExtent = {((screenMax.x - screenOrigin.x) / 2), TextureLibrary[t_ceiling_left].height * 0.5f };
-	ceiling = CreateSolid(ceilPos, ceilExtent, nullptr, WHITE, worldId);
-
-	b2Vec2 boxExtent = { 0.5f * TextureLibrary[t_box].width, 0.5f * TextureLibrary[t_box].height };
-	for (int i = 0; i < BOX_COUNT; ++i)
-	{
-		float y = height - boxExtent.y - 100.0f - (2.5f * i + 2.0f) * boxExtent.y - 20.0f;
-		float x = 0.5f * width + (3.0f * i - 3.0f) * boxExtent.x;
-		Entity box = CreatePhysicsBox((b2Vec2){x, y}, boxExtent, &TextureLibrary[t_box], worldId);
-		boxEntities[i] = box;
+/**
+ * A frame of the loading screen. Each one decodes some more of the assets and draws how far along they are,
+ * so the window responds from the start. The frame that finishes the loading builds the world.
+ */
+void LoadingFrame(void){
+	if (LoadAssetsStep()) {
+		InitVoices();
+		GameConfig config = WorldConfig(true);
+		InitWorld(&game, &config);
+		InvalidateStaticLayer(&staticLayer);
+		StartRecording(worldSeed);
+		// The world starts from this frame, not from however long loading took
+		tickAccumulator = 0.0f;
+		loading = false;
 	}
 
-	// Create the paddle
-	paddle = CreatePaddle(
-		(b2Vec2){
-			width / 2.0f, 
-			height * 0.95f
-		}, 
-		1.2f * lengthUnitsPerMeter, 
-		0.4f * lengthUnitsPerMeter,
-		BLUE, 
-		worldId
-		);
-
-	// Create the paddle's movement limit
-	// TODO: Make special function for this
-	b2Vec2 limPos = {width / 2.0f, height * 0.85f + TextureLibrary[t_limit].height / 2.0f};
-	b2Vec2 limExtent = {width, 16};
-	limit = CreateSolid(
-		limPos,
-		limExtent,
-		nullptr, WHITE, worldId
-		);
-	
-	b2Filter filt = { 0 };
-	filt.categoryBits = BALLTHRU;
-	filt.maskBits = PADDLE | TARGET;
-	b2Shape_SetFilter(limit.shapeId, filt);
-
-	// Establish the inner bounds of the arena
-	// TODO: Clean this up (move to arena.c?)
-	float innerWidth = (rPos.x - rightWall.extent.x) - (lPos.x + leftWall.extent.x);
-	float innerHeight =  (limPos.y - limExtent.y) - (ceilPos.y + ceilExtent.y);
-	Vector2 innerOrigin = {(lPos.x + leftWall.extent.x), (ceilPos.y + ceilExtent.y)};
-
-	// Establish the death zone
-	// TODO: Allow levels to define their specific death zone
-	float dzHeight = 100;
-	b2Vec2 dzExtent = {innerWidth / 2, dzHeight};
-	b2Vec2 dzPos = {innerOrigin.x + dzExtent.x, screenMax.y - dzExtent.y};
-	deathZone = CreateDeathZone(dzPos, dzExtent, nullptr, WHITE, worldId);
-
-	mousePosition = GetMousePosition();
-	mouseDelta = GetMouseDelta();
-
-	Vector2 center = {
-		screenMax.x - (screenMax.x - screenOrigin.x) / 2, 
-		screenMax.y - (screenMax.y - screenOrigin.y) / 2
-	};
-	Rectangle pauseMenuBounds = {
-		center.x - innerWidth  / 8, 
-		center.y - innerHeight  / 2, 
-		innerWidth / 4, 
-		innerHeight
-	};
-	pauseMenu = CreatePauseMenu(
-		&gameState, 
-		pauseMenuBounds);
-	//printf("Available Width / Height: %.3f / %.3f", innerWidth, innerHeight);
-	level = LoadLevel(levelRooms, innerOrigin, worldId);
-
-	//TODO: Investigate further why ballspawn is not where it should be
-	Vector2 ballTest = GetWorldToScreen2D(
-		(Vector2){
-			level.ballSpawn.x, 
-			level.ballSpawn.y
-		}, camera);
-	ballEntity = CreateBall(
-		(b2Vec2){ballTest.x, ballTest.y},
-		0.3f * lengthUnitsPerMeter,
-		&TextureLibrary[t_ball],
-		PURPLE,
-		worldId
-		);
+	int barWidth = width / 3;
+	int barHeight = 24;
+	int barX = (width - barWidth) / 2;
+	int barY = height / 2;
+	BeginDrawing();
+	ClearBackground(DARKGRAY);
+	DrawText("Loading", barX, barY - 40, 30, RAYWHITE);
+	DrawRectangle(barX, barY, (int)(barWidth * AssetLoadingProgress()), barHeight, RAYWHITE);
+	DrawRectangleLines(barX, barY, barWidth, barHeight, RAYWHITE);
+	EndDrawing();
+	LogPump();
 }
 
-void Update(void) {
-	mouseInWorld = GetScreenToWorld2D(mousePosition, camera);
-	if (IsKeyPressed(KEY_P))
-	{
-		gameState.paused = !gameState.paused;
-	}
+void DrawFrame(void){
+	// #############
+	// Drawing logic
+	// #############
 
-	// Reset boxes and ball
-	if (IsKeyPressed(KEY_R)) {
-		for (int i = 0; i < BOX_COUNT; ++i) {
-			Entity* entity = boxEntities + i;
-			b2Body_SetLinearVelocity(entity->bodyId, b2Vec2_zero);
-			b2Body_SetTransform(entity->bodyId,
-				(b2Vec2){
-					128 + (float)(width-64)/BOX_COUNT * (float)(i/(1+i%2)),
-					i%2 * 128
-				},
-				b2Body_GetRotation(entity->bodyId));
-		}
-	}
+	ProfileBegin(PROFILE_DRAW);
+	// Only redraws the arena and level blocks when the camera or level changed.
+	// The blocks are part of this bottom layer, so boxes now draw over them rather than under.
+	UpdateStaticLayer(&staticLayer, &game.camera, &game.level, DARKGRAY);
+	// Likewise the HUD and menu only recompose when the score or menu changed
+	UpdateHUD(&hud, &game.gameState);
+	if (game.gameState.paused && game.pauseMenu != nullptr)
+		UpdatePauseMenu(game.pauseMenu);
 
-	if (IsKeyPressed(KEY_T)) {
-		ResetBall(&ballEntity);
-	}
+	ClearBackground(DARKGRAY);
+	BeginDrawing();
+	DrawStaticLayer(&staticLayer);
 
-	if (IsKeyDown(KEY_D)) {
-		camera.rotation += 5;
-	}
+	char debugText[32];
+	snprintf(debugText, sizeof(debugText), "Rot: %.3f", game.camera.rotation);
+	DrawText(debugText, 0, 0, 25, BLACK);
+	BeginMode2D(game.camera);
+	// Draw cursor
+	DrawCircle((int)game.mouseInWorld.x, (int)game.mouseInWorld.y, 10.0f, RED);
 
-	if (IsKeyDown(KEY_A)) {
-		camera.rotation -= 5;
-	}
 
-	// ######################
-	// Game and physics logic
-	// #######################
-
-	mousePosition = GetMousePosition();
-	mouseDelta = GetMouseDelta();
-
-	mouseInWorld = GetScreenToWorld2D(mousePosition, camera);
-	mVec = (b2Vec2){mouseInWorld.x, mouseInWorld.y};
-
-	memset(VectorsToDraw, 0, sizeof VectorsToDraw);
-
-	int VecIndex = 0;
-
-	paddle.tilt = 0;
-	Color color = RED;
-	if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) || IsMouseButtonDown(MOUSE_BUTTON_RIGHT)) {
-		// Mouse left allows picking up a box
-		if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && !holdingEntity) {
-			paddle.tilt = -1;
-			// Loop through all the boxes
-			for (int i = 0; i < BOX_COUNT; ++i) {
-				Entity* entity = boxEntities + i;
-				b2Vec2 pob = b2Body_GetLocalPoint(entity->bodyId, mVec);
-
-				// If the mouse coord as a local point (origin is center on box) is within the bounds of the box
-				if (fabsf(pob.x) <= entity->extent.x && fabsf(pob.y) <= entity->extent.y) {
-					// Debug color
-					color = BLUE;
-					// Set variables required for holding a box (logic is applied later)
-					holdingEntity = true;
-					lastHeldEntity = entity;
-					break;
-				}
-			}
-		}
-		// Mouse right creates a radial force-field that pushes the boxes away based on the distance to the mouse
-		else if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT)) {
-			paddle.tilt = 1;
-			for (int i = 0; i < BOX_COUNT; ++i) {
-				Entity* entity = boxEntities + i;
-				b2Vec2 pob = b2Body_GetLocalPoint(entity->bodyId, mVec);
-				//b2Vec2 distVec = {pob.x * -1, pob.y * -1};
-				b2Vec2 entityPos = b2Body_GetWorldCenterOfMass(entity->bodyId);
-				b2Vec2 distVec = {entityPos.x - mVec.x, entityPos.y - mVec.y};
-				float distMag = (float)sqrt(pow(distVec.x, 2) + pow(distVec.y, 2));
-				float maxDistance = 256;
-				if (distMag > maxDistance) {
-					continue;
-				}
-				b2Vec2 distNorm = b2Normalize(distVec);
-				b2Vec2 maxForce = {10, 10};
-				b2Vec2 maxVec = b2Mul(distNorm, maxForce);
-				b2Vec2 str = b2Lerp((b2Vec2){0, 0}, maxVec, distMag);
-				VectorsToDraw[VecIndex++] = str;
-				b2Body_SetLinearVelocity(entity->bodyId, str);
-				//b2Body_ApplyForce(entity->bodyId, str, mVec, true);
-				if (fabsf(pob.x) <= entity->extent.x && fabsf(pob.y) <= entity->extent.y) {
-					color = BLUE;
-					if (DEBUG) printf("(%.2f, %.2f)\n", pob.x, pob.y);
-				}
+	// Draw force-field vectors (debugging)
+	if (DEBUG) {
+		for (int i = 0; i < BOX_COUNT; ++i) {
+			b2Vec2* vec = game.VectorsToDraw + i;
+			if (vec->x != 0 && vec->y != 0) {
+				rlSetLineWidth(3);
+				DrawLine(game.mVec.x, game.mVec.y, vec->x, vec->y, BLUE);
 			}
 		}
 	}
 
-	// Logic for ensuring a held box follows the mouse cursor
-	if (holdingEntity && lastHeldEntity != NULL) {
-		//b2Body_SetTransform(lastHeldEntity->bodyId, mVec, b2Body_GetRotation(lastHeldEntity->bodyId));
-		//b2Body_SetLinearVelocity(lastHeldEntity->bodyId, (b2Vec2){0, 0});
-		b2Transform target = {
-			mVec,
-			b2Body_GetRotation(lastHeldEntity->bodyId)
-		};
-		b2Body_SetTargetTransform(lastHeldEntity->bodyId, target, 0.1f);
-	}
-
-	// Logic for releasing a held box
-	if (IsMouseButtonUp(MOUSE_BUTTON_LEFT) && holdingEntity && lastHeldEntity != NULL) {
-		holdingEntity = false;
-	}
+	//DrawEntity(&rightWall);
 
-	if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-		PauseMenuHandleClick(pauseMenu, mouseInWorld);
+	// Predicted path of the tracked ball, and where it lands on the paddle
+	DrawTrajectory(&game.trajectory, RED);
+	if (game.paddleCast.shapeId.index1 == game.paddle.shapeId.index1) {
+		Vector2 hitPoint = { game.paddleCast.point.x, game.paddleCast.point.y };
+		DrawLine(hitPoint.x,  hitPoint.y, hitPoint.x + game.paddleCast.normal.x, hitPoint.y + game.paddleCast.normal.y, BLUE);
+        b2Vec2 adjustment = b2MulSV(game.balls.radii[game.trackedBall], game.paddleCast.normal);
+        b2Vec2 adjPos = b2Add(game.paddleCast.point, adjustment);
+		rlSetLineWidth(3.0f);
+		DrawLine(game.paddleCast.point.x, game.paddleCast.point.y, adjPos.x, adjPos.y, PINK);
 	}
 
-	// Logic for killing a ball if it hits death zone
-	b2Vec2 ballPos = b2Body_GetPosition(ballEntity.bodyId);
-	b2Vec2 ballToDeath = b2Body_GetLocalPoint(deathZone.bodyId, ballPos);
-	if (fabsf(ballToDeath.x) <= deathZone.extent.x && fabsf(ballToDeath.y) <= deathZone.extent.y) {
-		ResetBall(&ballEntity);
-	}
+	// Draw physics-based boxes
+	DrawDebris(&game.debris);
+
+	DrawLevel(&game.level);
+
+	DrawBalls(&game.balls);
+	DrawEntity(&game.deathZone);
+	DrawPaddle(&game.paddle);
+	//DrawEntity(&game.limit);
+	DrawLimit(&game.limit);
+	// The world's sprites go below the menu and HUD
+	FlushSprites();
+	if (game.gameState.paused && game.pauseMenu != nullptr)
+		DrawPauseMenu(game.pauseMenu);
+	DrawCircle((int)game.paddleTarget.x, (int)game.paddleTarget.y, 10.0f, PURPLE);
+	DrawHUD(&hud, game.screenBounds);
+	FlushSprites();
+	EndMode2D();
+	if (showProfiler)
+		DrawProfilerOverlay((Vector2){ 20, 120 });
+	// Presenting the frame waits for vsync, which is not drawing time
+	ProfileEnd(PROFILE_DRAW);
+	EndDrawing();
+}
 
-	// Prevent high-velocity shots by having cursor above limit
-	paddleTarget = mVec;
-	if (paddleTarget.y < height / 2.0f) {
-		paddleTarget.y = height / 2.0f;
+/**
+ * Start writing the input of the world just built to --record, if given.
+ * @param seed The seed the world was built or restarted with
+ */
+void StartRecording(uint64_t seed) {
+	if (recordPath == nullptr || recorder.file != nullptr)
+		return;
+	TraceHeader header = { .seed = seed, .tickRate = tickRate, .startingBalls = startingBalls, .boxCount = boxCount };
+	snprintf(header.levelPath, sizeof header.levelPath, "%s", levelPath);
+	if (!BeginRecording(&recorder, recordPath, &header)) {
+		GAME_LOG(SEVERITY_ERROR, LOGCAT_GENERAL, "Could not record to %s", recordPath);
+		recordPath = nullptr;
 	}
-	b2Vec2 paddlePos = b2Body_GetPosition(paddle.bodyId);
-	float limitBottom = b2Body_GetPosition(limit.bodyId).y + limit.extent.y;
-	if (paddleTarget.y <= paddlePos.y && paddle.touchingLimit && paddle.timeDelta > 0.1f) {
-		paddleTarget.y = limitBottom + paddle.extent.y;
-	}
-
-	// Raycast Collision
+}
 
-	// Reset the ballcast result 
-	memset(&context, 0, sizeof(context));
-	
-	context.targetShapeId = paddle.shapeId;
-	origin = b2Body_GetPosition(ballEntity.bodyId);
-	translation = b2MulSV(100000, b2Normalize(b2Body_GetLinearVelocity(ballEntity.bodyId)));
-	//translation.x = translation.x * (1.0f / 60.0f);
-	//translation.y = translation.y * (1.0f / 60.0f);
-	b2QueryFilter filter = {RAY, PADDLE};
-	b2ShapeProxy ballProx = b2MakeProxy(&ballPos, 1, ballEntity.radius);
-	b2World_CastShape(worldId, &ballProx, translation, filter, BallRayResultFcn, &context);
+void StopRecording(void) {
+	if (recorder.file == nullptr)
+		return;
+	uint32_t tickCount = recorder.header.tickCount;
+	if (EndRecording(&recorder))
+		GAME_LOG(SEVERITY_INFO, LOGCAT_GENERAL, "Recorded %u ticks to %s", tickCount, recordPath);
+	else
+		GAME_LOG(SEVERITY_ERROR, LOGCAT_GENERAL, "Could not finish the trace %s", recordPath);
+	recordPath = nullptr;
+}
 
-	if (DEBUG) {
-		//b2World_CastRay(worldId, origin, translation, filter, &BallRayResultFcn, &context);
-		if (context.shapeId.index1 == paddle.shapeId.index1)
-			printf("Context: ShapeID: %d, Point: (%.2f, %.2f), Normal: (%.2f, %.2f), Frac: (%.8f) \n", context.shapeId.index1, context.point.x, context.point.y, context.normal.x, context.normal.y, context.fraction);
+/**
+ * Play a trace back without a window, as fast as possible, and report how long the simulation took.
+ * @return The process exit code
+ */
+int RunReplay(void) {
+	float deltaTime = 1.0f / tickRate;
+	GameConfig config = WorldConfig(false);
+	InitWorld(&game, &config);
+
+	InputState input;
+	uint64_t startTicks = b2GetTicks();
+	while (true) {
+		ProfilerBeginFrame();
+		ProfileBegin(PROFILE_INPUT);
+		bool more = ReplayInput(&replay, &input);
+		ProfileEnd(PROFILE_INPUT);
+		if (!more)
+			break;
+		Update(&game, &input, deltaTime);
+		ProfilerEndFrame();
 	}
-
-	// Set the paddle velocity required to approach the cursor the next timestep
-	UpdatePaddle(&paddle, paddleTarget);
-
-	// Get the magnitude of the paddle velocity
-	b2Vec2 paddleVelocity = b2Body_GetLinearVelocity(paddle.bodyId);
-	float paddleSpeed = sqrt(paddleVelocity.x * paddleVelocity.x + paddleVelocity.y * paddleVelocity.y);
-
-	// If paddle is moving fast enough, perform extra collision checks to prevent tunneling
-	if(paddleSpeed > 2000.0f){
-		printf("Paddlespeed: %.4f \n", paddleSpeed);
-		CheckBallPaddleCollision(&ballEntity, &paddle, &context);
+	float elapsedMs = b2GetMilliseconds(startTicks);
+
+	bool complete = replay.tick == replay.header.tickCount;
+	if (!complete)
+		GAME_LOG(SEVERITY_ERROR, LOGCAT_GENERAL, "Trace %s ends after %u of %u ticks", replayPath, replay.tick, replay.header.tickCount);
+	printf("Replay %s: %u ticks at %.0f Hz in %.3f ms of sim time\n", replayPath, replay.tick, tickRate, elapsedMs);
+	printf("  %.2f us/tick, final score %d\n", replay.tick > 0 ? elapsedMs * 1000.0 / replay.tick : 0.0, game.gameState.score);
+	DestroyWorld(&game);
+
+	if (profilePath != nullptr && !WriteProfileCsv(profilePath)) {
+		GAME_LOG(SEVERITY_ERROR, LOGCAT_GENERAL, "Could not write profile %s", profilePath);
+		return 1;
 	}
+	return complete ? 0 : 1;
+}
 
-	if (gameState.paused == false)
-	{
-		float deltaTime = GetFrameTime();
-		b2World_Step(worldId, deltaTime / 1, 16);
+/**
+ * A headless run's episodes, shared by the jobs that play them.
+ */
+typedef struct HeadlessBatch {
+	GameConfig config;
+	int ticks;
+	float deltaTime;
+	// Filled in per episode
+	int* scores;
+	// Set by whichever job runs out of memory
+	atomic_bool failed;
+} HeadlessBatch;
+
+/**
+ * Play a range of a headless run's episodes in one world of their own. Runs as a ParallelFor job.
+ * The world is built for the first episode and restarted for the rest, reusing its bodies.
+ * Every episode seeds its world with the run's seed plus its index, so the episodes play out differently
+ * but the same on every run. Only the first episode is recorded and profiled.
+ */
+void RunEpisodes(int startIndex, int endIndex, uint32_t workerIndex, void* context) {
+	HeadlessBatch* batch = context;
+	Vector2 screenSize = { width, height };
+	GameContext* world = malloc(sizeof *world);
+	if (world == nullptr) {
+		atomic_store(&batch->failed, true);
+		return;
 	}
 
-	// #################
-	// Collision logic
-	// #################
-	b2ContactEvents contactEvents = b2World_GetContactEvents(worldId);
-	if (contactEvents.beginCount > 0 || contactEvents.endCount > 0 || contactEvents.hitCount > 0 )
-		if (DEBUG) printf("Contact begin: %d, Contact end: %d, Hits: %d\n", contactEvents.beginCount, contactEvents.endCount, contactEvents.hitCount);
-
-	for (int i = 0; i < contactEvents.hitCount; ++i)
-	{
-		b2ContactHitEvent* hitEvent = contactEvents.hitEvents + i;
-		if (DEBUG) printf("ShapeIDA: %lu, ShapeIDB: %lu\n", b2Shape_GetFilter(hitEvent->shapeIdA).categoryBits, b2Shape_GetFilter(hitEvent->shapeIdB).categoryBits);
-		uint64_t shapeACategory = b2Shape_GetFilter(hitEvent->shapeIdA).categoryBits;
-		uint64_t shapeBCategory = b2Shape_GetFilter(hitEvent->shapeIdB).categoryBits;
-
-		// If BALL (2) collides with TARGET (1)
-		if (abs((int)(shapeACategory - shapeBCategory)) == 1) {
-			b2ShapeId shape;
-			if (shapeACategory == BALL)
-				shape = hitEvent->shapeIdB;
-			else
-				shape = hitEvent->shapeIdA;
-			b2BodyId targetBody = b2Shape_GetBody(shape);
-			for (int j = 0; j < level.targetCount; j++) {
-				if (level.targets[j].bodyId.index1 == targetBody.index1) {
-					if (level.targets[j].state == 0) {
-						level.targets[j].state = 1;
-						//b2MassData massData = b2Body_GetMassData(targetBody);
-						//massData.mass = 5.0f;
-						//b2Body_SetMassData(targetBody, massData);
-						b2Body_SetType(targetBody, b2_dynamicBody);
-						b2Vec2 ballVel = b2Body_GetLinearVelocity(ballEntity.bodyId);
-						ballVel.x *= -1;
-						ballVel.y *= -1;
-						b2Body_SetLinearVelocity(targetBody, ballVel);
-						gameState.score += 20;
-					}
-					else if (level.targets[j].state == 1){
-						//b2DestroyBody(level.targets[j].bodyId);
-						b2Body_Disable(targetBody);
-						gameState.score += 30;
-					}
-				}
-
-			}
-			int r = rand() % 4;
-			SetSoundVolume(SoundLibrary[s_target_1 + r], 0.75f);
-			PlaySound(SoundLibrary[s_target_1 + r]);
-		}
-		// IF BALL (2) collides with PADDLE (22)
-		if (abs((int)(shapeACategory - shapeBCategory)) == 20) {
-			b2ShapeId shape;
-			if (shapeACategory == BALL)
-				shape = hitEvent->shapeIdA;
-			else
-				shape = hitEvent->shapeIdB;
-
-			// Audio level determination
-			b2BodyId ballBody = b2Shape_GetBody(shape);
-			b2Vec2 vel = b2Body_GetLinearVelocity(ballBody);
-			float volMod = sqrt((pow(vel.x, 2) + pow(vel.y, 2))) * 1;
-			float vol = InvLerp(0, 10000, volMod);
-			vol = 1.0f / pow(vol, -0.5);
-			//printf("Volume: %.2f\n", volMod);
-			int r = rand() % 3;
-			SetSoundVolume(SoundLibrary[s_paddle_1 + r], vol);
-			PlaySound(SoundLibrary[s_paddle_1 + r]);
+	for (int episode = startIndex; episode < endIndex; episode++) {
+		bool first = episode == 0;
+		uint64_t seed = batch->config.seed + (uint64_t)episode;
+		if (episode == startIndex) {
+			GameConfig config = batch->config;
+			config.seed = seed;
+			InitWorld(world, &config);
 		}
-	}
-
-	// BeginTouchEvents
-	for (int i = 0; i < contactEvents.beginCount; ++i) {
-		b2ContactBeginTouchEvent* beginEvent = contactEvents.beginEvents + i;
-		uint64_t shapeACategory = b2Shape_GetFilter(beginEvent->shapeIdA).categoryBits;
-		uint64_t shapeBCategory = b2Shape_GetFilter(beginEvent->shapeIdB).categoryBits;
-		// IF PADDLE (22) touches LIMIT (32)
-		if (abs((int)(shapeACategory - shapeBCategory)) == 10) {
-			paddle.touchingLimit = true;
-			paddle.lastTouchTime = GetTime();
+		else {
+			// RestartLevel reseeds the world from its config
+			world->config.seed = seed;
+			RestartLevel(world);
 		}
-	}
-
-	// EndTouchEvents
-	for (int i = 0; i < contactEvents.endCount; ++i) {
-		b2ContactEndTouchEvent* touchEvent = contactEvents.endEvents + i;
-		uint64_t shapeACategory = b2Shape_GetFilter(touchEvent->shapeIdA).categoryBits;
-		uint64_t shapeBCategory = b2Shape_GetFilter(touchEvent->shapeIdB).categoryBits;
-		// IF PADDLE (22) touches LIMIT (32)
-		if (abs((int)(shapeACategory - shapeBCategory)) == 10) {
-			paddle.touchingLimit = false;
+		if (first)
+			StartRecording(seed);
+		for (int tick = 0; tick < batch->ticks; tick++) {
+			// The scripted player follows where the ball will come down to the paddle, or the ball itself
+			int lowest = LowestBall(&world->balls);
+			b2Vec2 ballPos = lowest >= 0 ? world->balls.positions[lowest] : world->ballSpawn;
+			b2Vec2 landing;
+			if (FindTrajectoryCrossing(&world->trajectory, b2Body_GetPosition(world->paddle.bodyId).y, &landing))
+				ballPos = landing;
+			Vector2 ballOnScreen = GetWorldToScreen2D((Vector2){ballPos.x, ballPos.y}, world->camera);
+			if (first)
+				ProfilerBeginFrame();
+			ProfileBegin(PROFILE_INPUT);
+			InputState input = ScriptedInput((uint64_t)tick, ballOnScreen, screenSize);
+			if (first)
+				RecordInput(&recorder, &input);
+			ProfileEnd(PROFILE_INPUT);
+			Update(world, &input, batch->deltaTime);
+			if (first)
+				ProfilerEndFrame();
 		}
+		if (first)
+			StopRecording();
+		batch->scores[episode] = world->gameState.score;
 	}
+	if (endIndex > startIndex)
+		DestroyWorld(world);
+	free(world);
 }
 
-void DrawFrame(void){
-	// #############
-	// Drawing logic
-	// #############
-
-	ClearBackground(DARKGRAY);
-	BeginDrawing();
-
-	char debugText[32];
-	snprintf(debugText, sizeof(debugText), "Rot: %.3f", camera.rotation);
-	DrawText(debugText, 0, 0, 25, BLACK);
-	BeginMode2D(camera);
-	// Draw cursor
-	DrawCircle((int)mouseInWorld.x, (int)mouseInWorld.y, 10.0f, RED);
-
-
-	// Draw force-field vectors (debugging)
-	if (DEBUG) {
-		for (int i = 0; i < BOX_COUNT; ++i) {
-			b2Vec2* vec = VectorsToDraw + i;
-			if (vec->x != 0 && vec->y != 0) {
-				rlSetLineWidth(3);
-				DrawLine(mVec.x, mVec.y, vec->x, vec->y, BLUE);
-			}
-		}
+/**
+ * Run the simulation without a window, audio or rendering, driven by ScriptedInput at a fixed tick.
+ * Every episode plays a world for a number of ticks, then restarts its level for the next one.
+ * Episodes share nothing, so they are spread over the job system's workers; a single episode instead
+ * runs box2d's solver on them.
+ * @param episodes How many worlds to simulate
+ * @param ticks How many fixed ticks to play per episode
+ * @param tickRate Simulation ticks per simulated second
+ * @return The process exit code
+ */
+int RunHeadless(int episodes, int ticks, float tickRate) {
+	if (episodes <= 0 || ticks <= 0 || tickRate <= 0.0f) {
+		GAME_LOG(SEVERITY_ERROR, LOGCAT_GENERAL, "Headless: episodes, ticks and tick rate must be positive");
+		return 1;
 	}
 
-	// Draw outer bounds
-
-	DrawBackground(&camera);
-	//DrawEntity(&rightWall);
-
-	// Ray-casting for landing
-	if (context.shapeId.index1 == paddle.shapeId.index1) {
-		Vector2 hitPoint = { origin.x + translation.x * context.fraction,  origin.y + translation.y * context.fraction};
-		DrawLine(origin.x, origin.y, hitPoint.x, hitPoint.y, RED);
-		DrawLine(hitPoint.x,  hitPoint.y, hitPoint.x + context.normal.x, hitPoint.y + context.normal.y, BLUE);
-        b2Vec2 adjustment = b2MulSV(ballEntity.radius, context.normal);
-        b2Vec2 adjPos = b2Add(context.point, adjustment);
-		rlSetLineWidth(3.0f);
-		DrawLine(context.point.x, context.point.y, adjPos.x, adjPos.y, PINK);
+	HeadlessBatch batch = {
+		.config = WorldConfig(false),
+		.ticks = ticks,
+		.deltaTime = 1.0f / tickRate,
+		.scores = calloc(episodes, sizeof(int)),
+	};
+	atomic_init(&batch.failed, false);
+	if (batch.scores == nullptr)
+		return 1;
+	batch.config.parallelSolver = episodes == 1;
+
+	uint64_t startTicks = b2GetTicks();
+	ParallelFor(episodes, 1, RunEpisodes, &batch);
+	float elapsedMs = b2GetMilliseconds(startTicks);
+
+	long long totalScore = 0;
+	for (int episode = 0; episode < episodes; episode++)
+		totalScore += batch.scores[episode];
+	free(batch.scores);
+	if (atomic_load(&batch.failed)) {
+		GAME_LOG(SEVERITY_ERROR, LOGCAT_GENERAL, "Headless: out of memory for worlds");
+		return 1;
 	}
 
-	DrawWalls(&camera);
-	DrawCeiling(&camera);
-
-	// Draw physics-based boxes
-	for (int i = 0; i < BOX_COUNT; ++i)
-	{
-		DrawEntity(boxEntities + i);
+	double totalTicks = (double)episodes * ticks;
+	double elapsedSeconds = elapsedMs / 1000.0;
+	printf("Headless: %d episodes x %d ticks at %.0f Hz on %d workers in %.3f s\n", episodes, ticks, tickRate, JobsWorkerCount(), elapsedSeconds);
+	printf("  %.0f ticks/s, %.1f episodes/s, %.2f us/tick, mean score %.1f\n",
+		totalTicks / elapsedSeconds,
+		episodes / elapsedSeconds,
+		elapsedMs * 1000.0 / totalTicks,
+		(double)totalScore / episodes);
+	// Only the last PROFILE_HISTORY ticks of the first episode are kept
+	if (profilePath != nullptr && !WriteProfileCsv(profilePath)) {
+		GAME_LOG(SEVERITY_ERROR, LOGCAT_GENERAL, "Could not write profile %s", profilePath);
+		return 1;
 	}
-
-	DrawLevel(&level);
-
-	DrawBall(&ballEntity);
-	DrawEntity(&deathZone);
-	DrawPaddle(&paddle);
-	//DrawEntity(&limit);
-	DrawLimit(&limit);
-	if (gameState.paused)
-		DrawPauseMenu(pauseMenu);
-	DrawCircle((int)paddleTarget.x, (int)paddleTarget.y, 10.0f, PURPLE);
-	DrawHUD(&gameState, screenBounds);
-	EndMode2D();
-	EndDrawing();
-}
\ No newline at end of file
+	return 0;
+}
@@ -0,0 +1,51 @@
+//
+// Created by frick on 2025-07-22.
+//
+
+#include "memarena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @param arena The arena to set up
+ * @param capacity Bytes to reserve up front. The arena never grows.
+ * @return False if the memory could not be allocated
+ */
+bool MemArenaInit(MemArena* arena, size_t capacity) {
+    arena->base = capacity > 0 ? malloc(capacity) : nullptr;
+    arena->capacity = arena->base != nullptr ? capacity : 0;
+    arena->used = 0;
+    return arena->base != nullptr || capacity == 0;
+}
+
+/**
+ * @param arena The arena to allocate from
+ * @param size Bytes to allocate
+ * @param align Alignment of the allocation, a power of two
+ * @return Zeroed memory, or nullptr if the arena is full
+ */
+void* MemArenaAlloc(MemArena* arena, size_t size, size_t align) {
+    size_t start = (arena->used + align - 1) & ~(align - 1);
+    if (start > arena->capacity || size > arena->capacity - start)
+        return nullptr;
+    arena->used = start + size;
+    void* memory = arena->base + start;
+    memset(memory, 0, size);
+    return memory;
+}
+
+/**
+ * Release everything allocated after a mark taken from arena->used.
+ */
+void MemArenaRewind(MemArena* arena, size_t mark) {
+    if (mark < arena->used)
+        arena->used = mark;
+}
+
+void MemArenaFree(MemArena* arena) {
+    free(arena->base);
+    arena->base = nullptr;
+    arena->capacity = 0;
+    arena->used = 0;
+}
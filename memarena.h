@@ -0,0 +1,29 @@
+//
+// Created by frick on 2025-07-22.
+//
+
+#ifndef MEMARENA_H
+#define MEMARENA_H
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A bump allocator over one block of memory. Allocations are never freed individually;
+ * everything goes at once with MemArenaFree (or MemArenaRewind back to an earlier mark).
+ */
+typedef struct MemArena {
+    uint8_t* base;
+    size_t capacity;
+    size_t used;
+} MemArena;
+
+bool MemArenaInit(MemArena* arena, size_t capacity);
+void* MemArenaAlloc(MemArena* arena, size_t size, size_t align);
+void MemArenaRewind(MemArena* arena, size_t mark);
+void MemArenaFree(MemArena* arena);
+
+#define MEMARENA_ALLOC(arena, type, count) ((type*)MemArenaAlloc((arena), sizeof(type) * (count), alignof(type)))
+// Worst case bytes for count values of type, including alignment padding
+#define MEMARENA_SIZE(type, count) (sizeof(type) * (count) + alignof(type) - 1)
+
+#endif //MEMARENA_H
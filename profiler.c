@@ -0,0 +1,159 @@
+//
+// Created by frick on 2025-07-24.
+//
+
+#include "profiler.h"
+#include <box2d/base.h>
+#include <box2d/box2d.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Every phase is timed with box2d's high resolution clock and summed over the frame. When a frame
+ * ends its sums go into a ring buffer holding the last PROFILE_HISTORY frames, together with
+ * box2d's counters, and the overlay and CSV dump are built from that history.
+ * Only the thread that began the frame is timed, so worlds simulated on other threads do not add to it.
+ */
+
+static const char* PhaseNames[ProfilePhaseCount] = {
+    [PROFILE_FRAME] = "frame",
+    [PROFILE_INPUT] = "input",
+    [PROFILE_GAMEPLAY] = "gameplay",
+    [PROFILE_TRAJECTORY] = "trajectory cast",
+    [PROFILE_PADDLE] = "paddle",
+    [PROFILE_STEP] = "step",
+    [PROFILE_EVENTS] = "events",
+    [PROFILE_DRAW] = "draw",
+    [PROFILE_B2_PAIRS] = "b2 pairs",
+    [PROFILE_B2_COLLIDE] = "b2 collide",
+    [PROFILE_B2_SOLVE] = "b2 solve",
+    [PROFILE_B2_REFIT] = "b2 refit",
+    [PROFILE_B2_BULLETS] = "b2 bullets",
+    [PROFILE_B2_SENSORS] = "b2 sensors",
+};
+
+typedef struct ProfileFrame {
+    float ms[ProfilePhaseCount];
+    int bodyCount;
+    int contactCount;
+} ProfileFrame;
+
+static ProfileFrame frames[PROFILE_HISTORY];
+static uint64_t frameCount = 0;
+static ProfileFrame current = { 0 };
+static uint64_t phaseStart[ProfilePhaseCount] = { 0 };
+static uint64_t frameStart = 0;
+static thread_local bool inFrame = false;
+
+void ProfilerBeginFrame(void) {
+    memset(&current, 0, sizeof current);
+    frameStart = b2GetTicks();
+    inFrame = true;
+}
+
+void ProfilerEndFrame(void) {
+    current.ms[PROFILE_FRAME] = b2GetMilliseconds(frameStart);
+    frames[frameCount % PROFILE_HISTORY] = current;
+    frameCount++;
+    inFrame = false;
+}
+
+void ProfileBegin(int phase) {
+    if (inFrame)
+        phaseStart[phase] = b2GetTicks();
+}
+
+void ProfileEnd(int phase) {
+    if (inFrame)
+        current.ms[phase] += b2GetMilliseconds(phaseStart[phase]);
+}
+
+/**
+ * Add box2d's timings for the step that just ran, and keep its body and contact counts.
+ */
+void ProfilerRecordWorld(b2WorldId worldId) {
+    if (!inFrame)
+        return;
+    b2Profile profile = b2World_GetProfile(worldId);
+    current.ms[PROFILE_B2_PAIRS] += profile.pairs;
+    current.ms[PROFILE_B2_COLLIDE] += profile.collide;
+    current.ms[PROFILE_B2_SOLVE] += profile.solve;
+    current.ms[PROFILE_B2_REFIT] += profile.refit;
+    current.ms[PROFILE_B2_BULLETS] += profile.bullets;
+    current.ms[PROFILE_B2_SENSORS] += profile.sensors;
+
+    b2Counters counters = b2World_GetCounters(worldId);
+    current.bodyCount = counters.bodyCount;
+    current.contactCount = counters.contactCount;
+}
+
+static int CompareFloats(const void* a, const void* b) {
+    float fa = *(const float*)a, fb = *(const float*)b;
+    return (fa > fb) - (fa < fb);
+}
+
+/**
+ * Draw min, average and 99th percentile of every phase over the recorded frames, in screen space.
+ * @param position Top left corner of the overlay
+ */
+void DrawProfilerOverlay(Vector2 position) {
+    int count = frameCount < PROFILE_HISTORY ? (int)frameCount : PROFILE_HISTORY;
+    if (count == 0)
+        return;
+
+    constexpr int fontSize = 20;
+    constexpr int lineHeight = 24;
+    DrawRectangle(position.x, position.y, 560, (ProfilePhaseCount + 2) * lineHeight + 8, (Color){0, 0, 0, 180});
+
+    char line[128];
+    float x = position.x + 8;
+    float y = position.y + 4;
+    snprintf(line, sizeof line, "%-16s %8s %8s %8s  (ms, %d frames)", "phase", "min", "avg", "p99", count);
+    DrawText(line, x, y, fontSize, WHITE);
+    y += lineHeight;
+
+    float samples[PROFILE_HISTORY];
+    for (int phase = 0; phase < ProfilePhaseCount; phase++) {
+        float sum = 0.0f;
+        for (int i = 0; i < count; i++) {
+            samples[i] = frames[i].ms[phase];
+            sum += samples[i];
+        }
+        qsort(samples, count, sizeof(float), CompareFloats);
+        float p99 = samples[(count * 99) / 100];
+        snprintf(line, sizeof line, "%-16s %8.3f %8.3f %8.3f", PhaseNames[phase], samples[0], sum / count, p99);
+        DrawText(line, x, y, fontSize, phase == PROFILE_FRAME ? YELLOW : WHITE);
+        y += lineHeight;
+    }
+
+    const ProfileFrame* last = frames + (frameCount - 1) % PROFILE_HISTORY;
+    snprintf(line, sizeof line, "bodies %d, contacts %d", last->bodyCount, last->contactCount);
+    DrawText(line, x, y, fontSize, LIGHTGRAY);
+}
+
+/**
+ * Write the recorded frames, oldest first, one row per frame and one column per phase (in ms).
+ * @return False if the file could not be written
+ */
+bool WriteProfileCsv(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr)
+        return false;
+
+    fprintf(file, "frame");
+    for (int phase = 0; phase < ProfilePhaseCount; phase++)
+        fprintf(file, ",%s", PhaseNames[phase]);
+    fprintf(file, ",bodies,contacts\n");
+
+    uint64_t first = frameCount > PROFILE_HISTORY ? frameCount - PROFILE_HISTORY : 0;
+    for (uint64_t f = first; f < frameCount; f++) {
+        const ProfileFrame* frame = frames + f % PROFILE_HISTORY;
+        fprintf(file, "%llu", (unsigned long long)f);
+        for (int phase = 0; phase < ProfilePhaseCount; phase++)
+            fprintf(file, ",%.4f", frame->ms[phase]);
+        fprintf(file, ",%d,%d\n", frame->bodyCount, frame->contactCount);
+    }
+    return fclose(file) == 0;
+}
@@ -0,0 +1,44 @@
+//
+// Created by frick on 2025-07-24.
+//
+
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <box2d/id.h>
+#include <raylib.h>
+
+/**
+ * The timed phases of a frame. Phases that run once per tick add up over the ticks in a frame.
+ * The PROFILE_B2_* phases are box2d's own breakdown of PROFILE_STEP, from b2World_GetProfile.
+ */
+enum ProfilePhase {
+    PROFILE_FRAME,
+    PROFILE_INPUT,
+    PROFILE_GAMEPLAY,
+    PROFILE_TRAJECTORY,
+    PROFILE_PADDLE,
+    PROFILE_STEP,
+    PROFILE_EVENTS,
+    PROFILE_DRAW,
+    PROFILE_B2_PAIRS,
+    PROFILE_B2_COLLIDE,
+    PROFILE_B2_SOLVE,
+    PROFILE_B2_REFIT,
+    PROFILE_B2_BULLETS,
+    PROFILE_B2_SENSORS,
+    ProfilePhaseCount
+};
+
+// Frames kept for statistics and the CSV dump, 10 seconds at 60 fps
+constexpr int PROFILE_HISTORY = 600;
+
+void ProfilerBeginFrame(void);
+void ProfilerEndFrame(void);
+void ProfileBegin(int phase);
+void ProfileEnd(int phase);
+void ProfilerRecordWorld(b2WorldId worldId);
+
+void DrawProfilerOverlay(Vector2 position);
+bool WriteProfileCsv(const char* path);
+
+#endif //PROFILER_H
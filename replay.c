@@ -0,0 +1,264 @@
+//
+// Created by frick on 2025-07-26.
+//
+
+#include "replay.h"
+#include "levelformat.h"
+
+#include <math.h>
+#include <string.h>
+
+constexpr uint8_t TRACE_REPEAT = 0x80;
+constexpr int TRACE_MAX_REPEAT = 0x7F;
+constexpr uint8_t TRACE_MOUSE_X = 1 << 0;
+constexpr uint8_t TRACE_MOUSE_Y = 1 << 1;
+constexpr uint8_t TRACE_DOWN = 1 << 2;
+constexpr uint8_t TRACE_PRESSED = 1 << 3;
+
+static void WriteU16(uint8_t* p, uint16_t value) {
+    p[0] = (uint8_t)(value & 0xFF);
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static void WriteU32(uint8_t* p, uint32_t value) {
+    WriteU16(p, (uint16_t)(value & 0xFFFF));
+    WriteU16(p + 2, (uint16_t)(value >> 16));
+}
+
+static uint16_t ReadU16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t ReadU32(const uint8_t* p) {
+    return (uint32_t)ReadU16(p) | ((uint32_t)ReadU16(p + 2) << 16);
+}
+
+static void WriteVarint(FILE* file, uint32_t value) {
+    while (value >= 0x80) {
+        fputc((int)(value & 0x7F) | 0x80, file);
+        value >>= 7;
+    }
+    fputc((int)value, file);
+}
+
+static bool ReadVarint(InputReplay* replay, uint32_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (replay->offset >= replay->size)
+            return false;
+        uint8_t byte = replay->bytes[replay->offset++];
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// Small changes of either sign become small unsigned numbers
+static uint32_t ZigZag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t UnZigZag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/*  #########################
+ *          RECORDING
+ *  #########################
+*/
+
+/**
+ * Start writing a trace.
+ * @param header The world the trace is played in. The tick count is filled in by EndRecording.
+ * @return False if the file could not be created or the level path is too long
+ */
+bool BeginRecording(InputRecorder* recorder, const char* path, const TraceHeader* header) {
+    memset(recorder, 0, sizeof *recorder);
+    size_t pathLength = strlen(header->levelPath);
+    if (pathLength > TRACE_MAX_LEVEL_PATH)
+        return false;
+    recorder->file = fopen(path, "wb");
+    if (recorder->file == nullptr)
+        return false;
+    recorder->header = *header;
+    recorder->header.tickCount = 0;
+
+    uint8_t bytes[TRACE_FILE_HEADER_SIZE];
+    uint32_t tickRateBits;
+    memcpy(&tickRateBits, &header->tickRate, sizeof tickRateBits);
+    memcpy(bytes, "RBRT", 4);
+    WriteU16(bytes + 4, TRACE_FILE_VERSION);
+    WriteU16(bytes + 6, (uint16_t)header->boxCount);
+    WriteU32(bytes + 8, (uint32_t)(header->seed & 0xFFFFFFFF));
+    WriteU32(bytes + 12, (uint32_t)(header->seed >> 32));
+    WriteU32(bytes + 16, tickRateBits);
+    WriteU32(bytes + 20, (uint32_t)header->startingBalls);
+    WriteU32(bytes + 24, 0);
+    WriteU16(bytes + 28, (uint16_t)pathLength);
+    fwrite(bytes, 1, sizeof bytes, recorder->file);
+    fwrite(header->levelPath, 1, pathLength, recorder->file);
+    return true;
+}
+
+static void FlushRepeats(InputRecorder* recorder) {
+    if (recorder->repeats > 0)
+        fputc(TRACE_REPEAT | recorder->repeats, recorder->file);
+    recorder->repeats = 0;
+}
+
+/**
+ * Append a tick's input to the trace. Call with exactly the input handed to Update.
+ * @param input The tick's input. The mouse position is rounded to what the trace can store,
+ * so that the recorded session plays out exactly like its replay will.
+ */
+void RecordInput(InputRecorder* recorder, InputState* input) {
+    if (recorder->file == nullptr)
+        return;
+    int32_t mouseX = (int32_t)lroundf(input->mousePosition.x * TRACE_MOUSE_SCALE);
+    int32_t mouseY = (int32_t)lroundf(input->mousePosition.y * TRACE_MOUSE_SCALE);
+    input->mousePosition = (Vector2){ mouseX / TRACE_MOUSE_SCALE, mouseY / TRACE_MOUSE_SCALE };
+    recorder->header.tickCount++;
+
+    if (mouseX == recorder->mouseX && mouseY == recorder->mouseY && input->down == recorder->down && input->pressed == 0) {
+        if (++recorder->repeats == TRACE_MAX_REPEAT)
+            FlushRepeats(recorder);
+        return;
+    }
+    FlushRepeats(recorder);
+
+    uint8_t flags = 0;
+    if (mouseX != recorder->mouseX)
+        flags |= TRACE_MOUSE_X;
+    if (mouseY != recorder->mouseY)
+        flags |= TRACE_MOUSE_Y;
+    if (input->down != recorder->down)
+        flags |= TRACE_DOWN;
+    if (input->pressed != 0)
+        flags |= TRACE_PRESSED;
+    fputc(flags, recorder->file);
+    if (flags & TRACE_MOUSE_X)
+        WriteVarint(recorder->file, ZigZag(mouseX - recorder->mouseX));
+    if (flags & TRACE_MOUSE_Y)
+        WriteVarint(recorder->file, ZigZag(mouseY - recorder->mouseY));
+    if (flags & TRACE_DOWN)
+        WriteVarint(recorder->file, input->down ^ recorder->down);
+    if (flags & TRACE_PRESSED)
+        WriteVarint(recorder->file, input->pressed);
+
+    recorder->mouseX = mouseX;
+    recorder->mouseY = mouseY;
+    recorder->down = input->down;
+}
+
+/**
+ * Finish the trace and close it.
+ * @return False if anything could not be written
+ */
+bool EndRecording(InputRecorder* recorder) {
+    if (recorder->file == nullptr)
+        return false;
+    FlushRepeats(recorder);
+    uint8_t tickCount[4];
+    WriteU32(tickCount, recorder->header.tickCount);
+    bool ok = fseek(recorder->file, 24, SEEK_SET) == 0
+        && fwrite(tickCount, 1, sizeof tickCount, recorder->file) == sizeof tickCount
+        && !ferror(recorder->file);
+    ok = fclose(recorder->file) == 0 && ok;
+    recorder->file = nullptr;
+    return ok;
+}
+
+/*  #########################
+ *          REPLAYING
+ *  #########################
+*/
+
+/**
+ * Open a trace for replaying. The header tells how to build the world it was recorded in.
+ * @return False if the file is missing or not a trace of a version we can read
+ */
+bool OpenReplay(InputReplay* replay, const char* path) {
+    memset(replay, 0, sizeof *replay);
+    replay->bytes = MapFile(path, &replay->size);
+    if (replay->bytes == nullptr)
+        return false;
+
+    const uint8_t* bytes = replay->bytes;
+    if (replay->size < TRACE_FILE_HEADER_SIZE || memcmp(bytes, "RBRT", 4) != 0 || ReadU16(bytes + 4) != TRACE_FILE_VERSION) {
+        CloseReplay(replay);
+        return false;
+    }
+    uint16_t pathLength = ReadU16(bytes + 28);
+    if (pathLength > TRACE_MAX_LEVEL_PATH || replay->size < TRACE_FILE_HEADER_SIZE + (size_t)pathLength) {
+        CloseReplay(replay);
+        return false;
+    }
+
+    TraceHeader* header = &replay->header;
+    uint32_t tickRateBits = ReadU32(bytes + 16);
+    header->seed = (uint64_t)ReadU32(bytes + 8) | ((uint64_t)ReadU32(bytes + 12) << 32);
+    memcpy(&header->tickRate, &tickRateBits, sizeof header->tickRate);
+    header->startingBalls = (int)ReadU32(bytes + 20);
+    header->boxCount = ReadU16(bytes + 6);
+    header->tickCount = ReadU32(bytes + 24);
+    memcpy(header->levelPath, bytes + TRACE_FILE_HEADER_SIZE, pathLength);
+    header->levelPath[pathLength] = '\0';
+    replay->offset = TRACE_FILE_HEADER_SIZE + pathLength;
+    return true;
+}
+
+/**
+ * Read the next tick's input.
+ * @param input Receives the input
+ * @return False once every tick has been played, or if the trace is cut short
+ */
+bool ReplayInput(InputReplay* replay, InputState* input) {
+    if (replay->bytes == nullptr || replay->tick >= replay->header.tickCount)
+        return false;
+
+    uint32_t pressed = 0;
+    if (replay->repeats > 0) {
+        replay->repeats--;
+    }
+    else {
+        if (replay->offset >= replay->size)
+            return false;
+        uint8_t flags = replay->bytes[replay->offset++];
+        if (flags & TRACE_REPEAT) {
+            replay->repeats = (flags & TRACE_MAX_REPEAT) - 1;
+        }
+        else {
+            uint32_t value;
+            if (flags & TRACE_MOUSE_X) {
+                if (!ReadVarint(replay, &value))
+                    return false;
+                replay->mouseX += UnZigZag(value);
+            }
+            if (flags & TRACE_MOUSE_Y) {
+                if (!ReadVarint(replay, &value))
+                    return false;
+                replay->mouseY += UnZigZag(value);
+            }
+            if (flags & TRACE_DOWN) {
+                if (!ReadVarint(replay, &value))
+                    return false;
+                replay->down ^= value;
+            }
+            if ((flags & TRACE_PRESSED) && !ReadVarint(replay, &pressed))
+                return false;
+        }
+    }
+
+    input->mousePosition = (Vector2){ replay->mouseX / TRACE_MOUSE_SCALE, replay->mouseY / TRACE_MOUSE_SCALE };
+    input->down = replay->down;
+    input->pressed = pressed;
+    replay->tick++;
+    return true;
+}
+
+void CloseReplay(InputReplay* replay) {
+    if (replay->bytes != nullptr)
+        UnmapFile(replay->bytes, replay->size);
+    memset(replay, 0, sizeof *replay);
+}
@@ -0,0 +1,77 @@
+//
+// Created by frick on 2025-07-26.
+//
+
+#ifndef REPLAY_H
+#define REPLAY_H
+#include "input.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Input traces (.rbt): every tick's InputState, plus what is needed to rebuild the same world.
+ *
+ * All values are little-endian.
+ *   offset  size  field
+ *        0     4  magic "RBRT"
+ *        4     2  version (TRACE_FILE_VERSION)
+ *        6     2  box count (0 in older traces, meaning BOX_COUNT)
+ *        8     8  RNG seed
+ *       16     4  tick rate in Hz (float)
+ *       20     4  starting ball count
+ *       24     4  tick count
+ *       28     2  level path length
+ *       30     -  level path, not terminated
+ *
+ * Then one record per tick, delta-encoded against the previous tick (which starts out all zero).
+ * A record starts with a byte that is either
+ *   1nnnnnnn  the last input repeats, with nothing pressed, for n more ticks (1 to 127)
+ *   0000pdyx  followed by, in this order and only if their bit is set,
+ *             x: the change in mouse x, y: the change in mouse y,
+ *             d: the held buttons XORed with the previous ones, p: the pressed buttons
+ * Mouse coordinates are stored in 1/TRACE_MOUSE_SCALE pixels as zigzag varints, buttons as varints.
+ */
+
+constexpr uint16_t TRACE_FILE_VERSION = 1;
+constexpr int TRACE_FILE_HEADER_SIZE = 30;
+constexpr float TRACE_MOUSE_SCALE = 16.0f;
+constexpr int TRACE_MAX_LEVEL_PATH = 255;
+
+typedef struct TraceHeader {
+    uint64_t seed;
+    float tickRate;
+    int startingBalls;
+    int boxCount;
+    uint32_t tickCount;
+    char levelPath[TRACE_MAX_LEVEL_PATH + 1];
+} TraceHeader;
+
+typedef struct InputRecorder {
+    FILE* file;
+    TraceHeader header;
+    int32_t mouseX, mouseY;
+    uint32_t down;
+    int repeats;
+} InputRecorder;
+
+typedef struct InputReplay {
+    const uint8_t* bytes;
+    size_t size;
+    size_t offset;
+    TraceHeader header;
+    int32_t mouseX, mouseY;
+    uint32_t down;
+    int repeats;
+    uint32_t tick;
+} InputReplay;
+
+bool BeginRecording(InputRecorder* recorder, const char* path, const TraceHeader* header);
+void RecordInput(InputRecorder* recorder, InputState* input);
+bool EndRecording(InputRecorder* recorder);
+
+bool OpenReplay(InputReplay* replay, const char* path);
+bool ReplayInput(InputReplay* replay, InputState* input);
+void CloseReplay(InputReplay* replay);
+
+#endif //REPLAY_H
@@ -0,0 +1,35 @@
+//
+// Created by frick on 2025-07-26.
+//
+
+#include "rng.h"
+
+// PCG32 (XSH RR), see https://www.pcg-random.org
+constexpr uint64_t PCG_MULTIPLIER = 6364136223846793005ull;
+constexpr uint64_t PCG_INCREMENT = 1442695040888963407ull;
+
+void SeedRandom(Random* random, uint64_t seed) {
+    random->state = 0;
+    NextRandom(random);
+    random->state += seed;
+    NextRandom(random);
+}
+
+uint32_t NextRandom(Random* random) {
+    uint64_t old = random->state;
+    random->state = old * PCG_MULTIPLIER + PCG_INCREMENT;
+    uint32_t xorShifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+    uint32_t rotation = (uint32_t)(old >> 59u);
+    return (xorShifted >> rotation) | (xorShifted << ((-rotation) & 31));
+}
+
+/**
+ * @param bound One more than the largest value wanted
+ * @return A number in [0, bound)
+ */
+int RandomInt(Random* random, int bound) {
+    if (bound <= 1)
+        return 0;
+    // Lemire's multiply-shift; the slight bias is irrelevant for picking sounds
+    return (int)(((uint64_t)NextRandom(random) * (uint32_t)bound) >> 32);
+}
@@ -0,0 +1,22 @@
+//
+// Created by frick on 2025-07-26.
+//
+
+#ifndef RNG_H
+#define RNG_H
+#include <stdint.h>
+
+/*
+ * The game's only source of randomness. Every world has its own, seeded when the world is built, and the seed
+ * is written into input traces, so a replayed session makes the same choices as the recorded one.
+ */
+
+typedef struct Random {
+    uint64_t state;
+} Random;
+
+void SeedRandom(Random* random, uint64_t seed);
+uint32_t NextRandom(Random* random);
+int RandomInt(Random* random, int bound);
+
+#endif //RNG_H
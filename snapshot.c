@@ -0,0 +1,277 @@
+//
+// Created by frick on 2025-07-27.
+//
+
+#include "snapshot.h"
+#include "box2d/box2d.h"
+#include "game.h"
+#include "interpolation.h"
+
+#include <string.h>
+
+static BodySnapshot SaveBody(b2BodyId bodyId) {
+    return (BodySnapshot){
+        b2Body_GetTransform(bodyId),
+        b2Body_GetLinearVelocity(bodyId),
+        b2Body_GetAngularVelocity(bodyId),
+        b2Body_IsAwake(bodyId),
+    };
+}
+
+static void LoadBody(const BodySnapshot* body, b2BodyId bodyId) {
+    b2Body_SetTransform(bodyId, body->transform.p, body->transform.q);
+    InterpolationSnap(bodyId);
+    if (b2Body_GetType(bodyId) == b2_staticBody)
+        return;
+    b2Body_SetLinearVelocity(bodyId, body->linearVelocity);
+    b2Body_SetAngularVelocity(bodyId, body->angularVelocity);
+    if (b2Body_IsAwake(bodyId) != body->awake)
+        b2Body_SetAwake(bodyId, body->awake);
+}
+
+/**
+ * Make room for a world's balls, boxes and targets. Balls always get the pool's full capacity.
+ * @return False if there was no memory, which leaves the snapshot empty
+ */
+static bool ReserveSnapshot(GameSnapshot* snapshot, int debrisCapacity, int targetCapacity) {
+    if (snapshot->arena.base != nullptr && debrisCapacity <= snapshot->debrisCapacity && targetCapacity <= snapshot->targetCapacity)
+        return true;
+    MemArenaFree(&snapshot->arena);
+    memset(snapshot, 0, sizeof *snapshot);
+
+    size_t size = MEMARENA_SIZE(uint8_t, BALL_POOL_CAPACITY) + 3 * MEMARENA_SIZE(int, BALL_POOL_CAPACITY)
+        + MEMARENA_SIZE(BodySnapshot, BALL_POOL_CAPACITY) + MEMARENA_SIZE(float, BALL_POOL_CAPACITY)
+        + MEMARENA_SIZE(Color, BALL_POOL_CAPACITY)
+        + MEMARENA_SIZE(uint8_t, debrisCapacity) + 2 * MEMARENA_SIZE(int, debrisCapacity)
+        + MEMARENA_SIZE(BodySnapshot, debrisCapacity)
+        + 2 * MEMARENA_SIZE(int, targetCapacity) + MEMARENA_SIZE(uint8_t, targetCapacity)
+        + MEMARENA_SIZE(BodySnapshot, targetCapacity);
+    MemArena* arena = &snapshot->arena;
+    if (!MemArenaInit(arena, size))
+        return false;
+    snapshot->ballStates = MEMARENA_ALLOC(arena, uint8_t, BALL_POOL_CAPACITY);
+    snapshot->ballFreeSlots = MEMARENA_ALLOC(arena, int, BALL_POOL_CAPACITY);
+    snapshot->balls = MEMARENA_ALLOC(arena, int, BALL_POOL_CAPACITY);
+    snapshot->ballBodies = MEMARENA_ALLOC(arena, BodySnapshot, BALL_POOL_CAPACITY);
+    snapshot->ballRadii = MEMARENA_ALLOC(arena, float, BALL_POOL_CAPACITY);
+    snapshot->ballSprites = MEMARENA_ALLOC(arena, int, BALL_POOL_CAPACITY);
+    snapshot->ballColors = MEMARENA_ALLOC(arena, Color, BALL_POOL_CAPACITY);
+    snapshot->debrisStates = MEMARENA_ALLOC(arena, uint8_t, debrisCapacity);
+    snapshot->debrisFreeSlots = MEMARENA_ALLOC(arena, int, debrisCapacity);
+    snapshot->debris = MEMARENA_ALLOC(arena, int, debrisCapacity);
+    snapshot->debrisBodies = MEMARENA_ALLOC(arena, BodySnapshot, debrisCapacity);
+    snapshot->targetStates = MEMARENA_ALLOC(arena, int, targetCapacity);
+    snapshot->targetTypes = MEMARENA_ALLOC(arena, uint8_t, targetCapacity);
+    snapshot->targetBodies = MEMARENA_ALLOC(arena, BodySnapshot, targetCapacity);
+    snapshot->liveTargets = MEMARENA_ALLOC(arena, int, targetCapacity);
+    snapshot->debrisCapacity = debrisCapacity;
+    snapshot->targetCapacity = targetCapacity;
+    return true;
+}
+
+/**
+ * Record a world's state. Cheap enough to do every tick: nothing is allocated once the snapshot has been
+ * sized for the world, and only bodies in play are read.
+ * @param snapshot Overwritten. Zero it before its first use.
+ * @return False if there was no memory for it
+ */
+bool TakeSnapshot(GameSnapshot* snapshot, const GameContext* game) {
+    const BallPool* balls = &game->balls;
+    const DebrisPool* debris = &game->debris;
+    const Level* level = &game->level;
+    if (!ReserveSnapshot(snapshot, debris->capacity, level->targetCount))
+        return false;
+
+    memcpy(snapshot->ballStates, balls->states, BALL_POOL_CAPACITY * sizeof *balls->states);
+    memcpy(snapshot->ballFreeSlots, balls->freeSlots, balls->freeCount * sizeof *balls->freeSlots);
+    snapshot->ballFreeCount = balls->freeCount;
+    snapshot->ballCount = balls->activeCount;
+    for (int i = 0; i < balls->activeCount; i++) {
+        int slot = balls->active[i];
+        snapshot->balls[i] = slot;
+        snapshot->ballBodies[i] = SaveBody(balls->bodyIds[slot]);
+        snapshot->ballRadii[i] = balls->radii[slot];
+        snapshot->ballSprites[i] = balls->sprites[slot];
+        snapshot->ballColors[i] = balls->colors[slot];
+    }
+
+    memcpy(snapshot->debrisStates, debris->states, debris->capacity * sizeof *debris->states);
+    memcpy(snapshot->debrisFreeSlots, debris->freeSlots, debris->freeCount * sizeof *debris->freeSlots);
+    snapshot->debrisFreeCount = debris->freeCount;
+    snapshot->debrisCount = debris->activeCount;
+    for (int i = 0; i < debris->activeCount; i++) {
+        int slot = debris->active[i];
+        snapshot->debris[i] = slot;
+        snapshot->debrisBodies[i] = SaveBody(debris->entities[slot].bodyId);
+    }
+    snapshot->heldBox = game->holdingEntity && game->lastHeldEntity != nullptr ? (int)(game->lastHeldEntity - debris->entities) : -1;
+
+    // Broken targets are disabled, and what they were doing when they broke no longer matters
+    snapshot->levelData = level->data;
+    snapshot->targetCount = level->targetCount;
+    for (int i = 0; i < level->targetCount; i++) {
+        const Target* target = level->targets + i;
+        snapshot->targetStates[i] = target->state;
+        snapshot->targetTypes[i] = SNAPSHOT_BROKEN_TARGET;
+        if (level->liveIndex[i] < 0)
+            continue;
+        snapshot->targetTypes[i] = (uint8_t)b2Body_GetType(target->bodyId);
+        snapshot->targetBodies[i] = SaveBody(target->bodyId);
+    }
+    memcpy(snapshot->liveTargets, level->liveTargets, level->liveCount * sizeof *level->liveTargets);
+    snapshot->liveCount = level->liveCount;
+
+    const Paddle* paddle = &game->paddle;
+    snapshot->paddle = SaveBody(paddle->bodyId);
+    snapshot->touchingLimit = paddle->touchingLimit;
+    snapshot->lastTouchTime = paddle->lastTouchTime;
+    snapshot->timeDelta = paddle->timeDelta;
+
+    snapshot->gameState = game->gameState;
+    snapshot->random = game->random;
+    snapshot->simulationTime = game->simulationTime;
+    snapshot->mousePosition = game->mousePosition;
+    snapshot->worldId = game->worldId;
+    snapshot->taken = true;
+    return true;
+}
+
+static void RestoreBalls(const GameSnapshot* snapshot, BallPool* balls) {
+    // Balls spawned since are despawned again, balls despawned since come back in their slots
+    for (int i = 0; i < balls->activeCount; i++) {
+        int slot = balls->active[i];
+        if (snapshot->ballStates[slot] != BALL_ACTIVE)
+            b2Body_Disable(balls->bodyIds[slot]);
+    }
+    for (int i = 0; i < snapshot->ballCount; i++) {
+        int slot = snapshot->balls[i];
+        b2BodyId bodyId = balls->bodyIds[slot];
+        if (balls->states[slot] != BALL_ACTIVE)
+            b2Body_Enable(bodyId);
+        if (balls->radii[slot] != snapshot->ballRadii[i]) {
+            b2Circle circle = {b2Vec2_zero, snapshot->ballRadii[i]};
+            b2Shape_SetCircle(balls->shapeIds[slot], &circle);
+            balls->radii[slot] = snapshot->ballRadii[i];
+        }
+        const BodySnapshot* body = snapshot->ballBodies + i;
+        LoadBody(body, bodyId);
+        balls->positions[slot] = body->transform.p;
+        balls->sprites[slot] = snapshot->ballSprites[i];
+        balls->colors[slot] = snapshot->ballColors[i];
+        // Don't streak the trail from where the ball was before
+        balls->trailHeads[slot] = 0;
+        for (int k = 0; k < BALL_TRACERS; k++)
+            balls->trails[slot][k] = body->transform.p;
+        balls->active[i] = slot;
+        balls->activeIndex[slot] = i;
+    }
+    memcpy(balls->states, snapshot->ballStates, BALL_POOL_CAPACITY * sizeof *balls->states);
+    memcpy(balls->freeSlots, snapshot->ballFreeSlots, snapshot->ballFreeCount * sizeof *balls->freeSlots);
+    balls->freeCount = snapshot->ballFreeCount;
+    balls->activeCount = snapshot->ballCount;
+}
+
+static void RestoreDebris(const GameSnapshot* snapshot, DebrisPool* debris) {
+    for (int i = 0; i < debris->activeCount; i++) {
+        int slot = debris->active[i];
+        if (snapshot->debrisStates[slot] != DEBRIS_ACTIVE)
+            b2Body_Disable(debris->entities[slot].bodyId);
+    }
+    for (int i = 0; i < snapshot->debrisCount; i++) {
+        int slot = snapshot->debris[i];
+        b2BodyId bodyId = debris->entities[slot].bodyId;
+        if (debris->states[slot] != DEBRIS_ACTIVE)
+            b2Body_Enable(bodyId);
+        LoadBody(snapshot->debrisBodies + i, bodyId);
+        debris->active[i] = slot;
+        debris->activeIndex[slot] = i;
+    }
+    memcpy(debris->states, snapshot->debrisStates, debris->capacity * sizeof *debris->states);
+    memcpy(debris->freeSlots, snapshot->debrisFreeSlots, snapshot->debrisFreeCount * sizeof *debris->freeSlots);
+    debris->freeCount = snapshot->debrisFreeCount;
+    debris->activeCount = snapshot->debrisCount;
+}
+
+/**
+ * @return True if a static target had to be moved back, so the static tree needs rebuilding
+ */
+static bool RestoreTargets(const GameSnapshot* snapshot, Level* level) {
+    // Targets that were broken then but are not now are broken again
+    for (int i = 0; i < level->liveCount; i++) {
+        int index = level->liveTargets[i];
+        if (snapshot->targetTypes[index] == SNAPSHOT_BROKEN_TARGET)
+            b2Body_Disable(level->targets[index].bodyId);
+    }
+
+    bool movedStatic = false;
+    for (int i = 0; i < snapshot->liveCount; i++) {
+        int index = snapshot->liveTargets[i];
+        Target* target = level->targets + index;
+        b2BodyType type = (b2BodyType)snapshot->targetTypes[index];
+        bool wasLive = level->liveIndex[index] >= 0;
+        if (!wasLive)
+            b2Body_Enable(target->bodyId);
+        // A target that has sat still since is where the snapshot found it
+        if (wasLive && type == b2_staticBody && target->state == snapshot->targetStates[index])
+            continue;
+        if (b2Body_GetType(target->bodyId) != type)
+            b2Body_SetType(target->bodyId, type);
+        LoadBody(snapshot->targetBodies + index, target->bodyId);
+        movedStatic |= type == b2_staticBody;
+    }
+
+    for (int i = 0; i < level->targetCount; i++) {
+        level->targets[i].state = snapshot->targetStates[i];
+        level->liveIndex[i] = -1;
+    }
+    for (int i = 0; i < snapshot->liveCount; i++) {
+        int index = snapshot->liveTargets[i];
+        level->liveTargets[i] = index;
+        level->liveIndex[index] = i;
+    }
+    level->liveCount = snapshot->liveCount;
+    return movedStatic;
+}
+
+/**
+ * Put a world back the way a snapshot of it found it. Bodies are moved, enabled and disabled in place,
+ * never created, so this is about as cheap as taking the snapshot.
+ * @return False if the snapshot is empty or was taken of another level or world, in which case nothing changes
+ */
+bool RestoreSnapshot(const GameSnapshot* snapshot, GameContext* game) {
+    Level* level = &game->level;
+    b2WorldId worldId = game->worldId;
+    if (!snapshot->taken || snapshot->worldId.index1 != worldId.index1 || snapshot->worldId.generation != worldId.generation
+        || snapshot->levelData != level->data || snapshot->targetCount != level->targetCount)
+        return false;
+
+    RestoreBalls(snapshot, &game->balls);
+    RestoreDebris(snapshot, &game->debris);
+    if (RestoreTargets(snapshot, level))
+        b2World_RebuildStaticTree(worldId);
+
+    Paddle* paddle = &game->paddle;
+    LoadBody(&snapshot->paddle, paddle->bodyId);
+    paddle->touchingLimit = snapshot->touchingLimit;
+    paddle->lastTouchTime = snapshot->lastTouchTime;
+    paddle->timeDelta = snapshot->timeDelta;
+
+    game->holdingEntity = snapshot->heldBox >= 0;
+    game->lastHeldEntity = snapshot->heldBox >= 0 ? game->debris.entities + snapshot->heldBox : nullptr;
+    // Pausing is the player's, not the world's: a retry from the pause menu stays paused
+    game->gameState.state = snapshot->gameState.state;
+    game->gameState.score = snapshot->gameState.score;
+    game->random = snapshot->random;
+    game->simulationTime = snapshot->simulationTime;
+    game->mousePosition = snapshot->mousePosition;
+    // The level's shapes may have moved, so the trajectory is predicted again
+    game->trackedBall = -1;
+    ResetTrajectory(&game->trajectory);
+    game->geometryVersion++;
+    return true;
+}
+
+void FreeSnapshot(GameSnapshot* snapshot) {
+    MemArenaFree(&snapshot->arena);
+    memset(snapshot, 0, sizeof *snapshot);
+}
@@ -0,0 +1,89 @@
+//
+// Created by frick on 2025-07-27.
+//
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "box2d/types.h"
+#include "raylib.h"
+#include "interface.h"
+#include "levelformat.h"
+#include "memarena.h"
+#include "rng.h"
+#include <stdint.h>
+
+typedef struct GameContext GameContext;
+
+constexpr uint8_t SNAPSHOT_BROKEN_TARGET = 0xFF;
+
+/**
+ * Where a body was and how it was moving.
+ */
+typedef struct BodySnapshot {
+    b2Transform transform;
+    b2Vec2 linearVelocity;
+    float angularVelocity;
+    bool awake;
+} BodySnapshot;
+
+/**
+ * Everything about a world that changes while it is played: the bodies in play and how they move, which targets
+ * are broken, the pools' bookkeeping, the paddle's contact state, the score and the RNG.
+ * Only the bodies in play are stored, so taking one costs about as much as walking the balls, boxes and targets once.
+ * box2d's contact cache is not part of it; contacts are found again on the next step.
+ * The arrays come from an arena that is sized on the first TakeSnapshot and grown when the world outgrows it.
+ */
+typedef struct GameSnapshot {
+    MemArena arena;
+    bool taken;
+    b2WorldId worldId;
+    int debrisCapacity;
+    int targetCapacity;
+
+    // Balls: the pool's bookkeeping, and the active balls in active order
+    uint8_t* ballStates;
+    int* ballFreeSlots;
+    int ballFreeCount;
+    int* balls;
+    BodySnapshot* ballBodies;
+    float* ballRadii;
+    int* ballSprites;
+    Color* ballColors;
+    int ballCount;
+
+    // Boxes, likewise
+    uint8_t* debrisStates;
+    int* debrisFreeSlots;
+    int debrisFreeCount;
+    int* debris;
+    BodySnapshot* debrisBodies;
+    int debrisCount;
+    int heldBox;
+
+    // Every target of the level, broken or not
+    const LevelData* levelData;
+    int targetCount;
+    int* targetStates;
+    // The b2BodyType of each live target, SNAPSHOT_BROKEN_TARGET for the broken ones
+    uint8_t* targetTypes;
+    BodySnapshot* targetBodies;
+    int* liveTargets;
+    int liveCount;
+
+    BodySnapshot paddle;
+    bool touchingLimit;
+    float lastTouchTime;
+    float timeDelta;
+
+    GameState gameState;
+    Random random;
+    float simulationTime;
+    Vector2 mousePosition;
+} GameSnapshot;
+
+bool TakeSnapshot(GameSnapshot* snapshot, const GameContext* game);
+bool RestoreSnapshot(const GameSnapshot* snapshot, GameContext* game);
+void FreeSnapshot(GameSnapshot* snapshot);
+
+#endif //SNAPSHOT_H
@@ -0,0 +1,73 @@
+//
+// Created by frick on 2025-07-23.
+//
+
+#include "sprites.h"
+
+extern TextureAtlas textureAtlas;
+
+/*  #########################
+ *     BATCHED SPRITE QUEUE
+ *  #########################
+ *
+ * Sprites are queued instead of drawn, then drawn grouped by atlas page when flushed, so that
+ * raylib only switches textures (and starts a new draw call) once per page.
+ * Everything queued is drawn with the transform that is active when FlushSprites is called,
+ * so flush before EndMode2D/EndTextureMode and before anything that must appear on top.
+ */
+
+constexpr int SPRITE_QUEUE_SIZE = 4096;
+
+typedef struct QueuedSprite {
+    Rectangle source;
+    Rectangle dest;
+    float rotation;
+    Color tint;
+    int page;
+} QueuedSprite;
+
+static QueuedSprite queue[SPRITE_QUEUE_SIZE];
+static int queueCount = 0;
+
+static void QueueSprite(int sprite, Rectangle dest, float rotation, Color tint) {
+    if (sprite < 0 || sprite >= TextureEnumSize)
+        return;
+    if (queueCount == SPRITE_QUEUE_SIZE)
+        FlushSprites();
+    AtlasSprite atlasSprite = textureAtlas.sprites[sprite];
+    queue[queueCount++] = (QueuedSprite){atlasSprite.source, dest, rotation, tint, atlasSprite.page};
+}
+
+/**
+ * Queue a sprite, like DrawTextureEx would draw its texture: rotated around its top left corner.
+ * @param sprite A TextureEnum
+ */
+void DrawSprite(int sprite, Vector2 position, float rotation, float scale, Color tint) {
+    if (sprite < 0 || sprite >= TextureEnumSize)
+        return;
+    Rectangle source = textureAtlas.sprites[sprite].source;
+    QueueSprite(sprite, (Rectangle){position.x, position.y, source.width * scale, source.height * scale}, rotation, tint);
+}
+
+/**
+ * Queue a sprite stretched over a rectangle.
+ * @param sprite A TextureEnum
+ */
+void DrawSpriteRec(int sprite, Rectangle dest, Color tint) {
+    QueueSprite(sprite, dest, 0.0f, tint);
+}
+
+/**
+ * Draw every queued sprite, page by page, keeping the queued order within each page.
+ */
+void FlushSprites(void) {
+    for (int page = 0; page < textureAtlas.pageCount; page++) {
+        Texture texture = textureAtlas.pages[page];
+        for (int i = 0; i < queueCount; i++) {
+            if (queue[i].page != page)
+                continue;
+            DrawTexturePro(texture, queue[i].source, queue[i].dest, (Vector2){0, 0}, queue[i].rotation, queue[i].tint);
+        }
+    }
+    queueCount = 0;
+}
@@ -0,0 +1,18 @@
+//
+// Created by frick on 2025-07-23.
+//
+
+#ifndef SPRITES_H
+#define SPRITES_H
+#include <raylib.h>
+
+#include "atlas.h"
+
+// Draw nothing, or a plain colored shape where an entity has no sprite
+constexpr int SPRITE_NONE = -1;
+
+void DrawSprite(int sprite, Vector2 position, float rotation, float scale, Color tint);
+void DrawSpriteRec(int sprite, Rectangle dest, Color tint);
+void FlushSprites(void);
+
+#endif //SPRITES_H
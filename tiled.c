@@ -0,0 +1,416 @@
+//
+// Created by frick on 2025-07-21.
+//
+
+#include "tiled.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*  #########################
+ *      STREAMING JSON
+ *  #########################
+ *
+ * Tiled maps are parsed in a single forward pass over the text, without building a tree.
+ * Only the pieces a level needs are looked at; everything else is skipped over.
+ */
+
+typedef struct JsonCursor {
+    const char* p;
+    const char* end;
+} JsonCursor;
+
+static void SkipSpace(JsonCursor* c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\n' || *c->p == '\r' || *c->p == '\t'))
+        c->p++;
+}
+
+static bool Expect(JsonCursor* c, char expected) {
+    SkipSpace(c);
+    if (c->p >= c->end || *c->p != expected)
+        return false;
+    c->p++;
+    return true;
+}
+
+/**
+ * Read a string in place. Escapes are skipped over but not decoded, which is all keys and tile layer types need.
+ */
+static bool ReadString(JsonCursor* c, const char** start, size_t* length) {
+    if (!Expect(c, '"'))
+        return false;
+    *start = c->p;
+    while (c->p < c->end && *c->p != '"') {
+        if (*c->p == '\\')
+            c->p++;
+        c->p++;
+    }
+    if (c->p >= c->end)
+        return false;
+    *length = (size_t)(c->p - *start);
+    c->p++;
+    return true;
+}
+
+static bool StringIs(const char* start, size_t length, const char* literal) {
+    return strlen(literal) == length && memcmp(start, literal, length) == 0;
+}
+
+static bool ReadInt(JsonCursor* c, long* value) {
+    SkipSpace(c);
+    bool negative = c->p < c->end && *c->p == '-';
+    if (negative)
+        c->p++;
+    if (c->p >= c->end || *c->p < '0' || *c->p > '9')
+        return false;
+    long result = 0;
+    while (c->p < c->end && *c->p >= '0' && *c->p <= '9')
+        result = result * 10 + (*c->p++ - '0');
+    *value = negative ? -result : result;
+    return true;
+}
+
+/**
+ * Skip any value, however deeply nested, keeping only a depth counter.
+ */
+static bool SkipValue(JsonCursor* c) {
+    SkipSpace(c);
+    int depth = 0;
+    while (true) {
+        if (c->p >= c->end)
+            return depth == 0;
+        char ch = *c->p;
+        if (ch == '"') {
+            const char* start;
+            size_t length;
+            if (!ReadString(c, &start, &length))
+                return false;
+            if (depth == 0)
+                return true;
+            continue;
+        }
+        if (ch == '{' || ch == '[') {
+            depth++;
+        }
+        else if (ch == '}' || ch == ']') {
+            // A scalar ends where its enclosing object or array does
+            if (depth == 0)
+                return true;
+            if (--depth == 0) {
+                c->p++;
+                return true;
+            }
+        }
+        else if (depth == 0 && (ch == ',' || ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t')) {
+            return true;
+        }
+        c->p++;
+    }
+}
+
+/*  #########################
+ *      TILE DATA FAST PATH
+ *  #########################
+ *
+ * Tile layers are long runs of "0, 0, 0, ...". Eight bytes are classified at once in a
+ * 64-bit register, and any chunk made only of zeros and separators is emitted as empty tiles
+ * without looking at its bytes one by one.
+ */
+
+static const uint64_t BYTES_01 = 0x0101010101010101ull;
+static const uint64_t BYTES_7F = 0x7F7F7F7F7F7F7F7Full;
+
+// 0x80 in every byte of x that is zero, 0x00 in every other byte
+static uint64_t ZeroBytes(uint64_t x) {
+    return ~(((x & BYTES_7F) + BYTES_7F) | x | BYTES_7F);
+}
+
+static uint64_t BytesEqual(uint64_t x, char value) {
+    return ZeroBytes(x ^ (BYTES_01 * (uint8_t)value));
+}
+
+/**
+ * Parse a tile layer's "data" array of global tile ids.
+ * @param c Positioned at the array
+ * @param tiles Receives the ids, which must each fit in a byte
+ * @param capacity How many ids fit in tiles
+ * @param count Receives the number of ids
+ */
+static bool ParseTileData(JsonCursor* c, uint8_t* tiles, int capacity, int* count) {
+    if (!Expect(c, '['))
+        return false;
+    int n = 0;
+    while (true) {
+        while (c->end - c->p >= 8) {
+            uint64_t chunk;
+            memcpy(&chunk, c->p, sizeof chunk);
+            uint64_t zeros = BytesEqual(chunk, '0');
+            uint64_t separators = BytesEqual(chunk, ',') | BytesEqual(chunk, ' ')
+                | BytesEqual(chunk, '\n') | BytesEqual(chunk, '\r') | BytesEqual(chunk, '\t');
+            if ((zeros | separators) != 0x8080808080808080ull)
+                break;
+            int emptyTiles = __builtin_popcountll(zeros);
+            if (n + emptyTiles > capacity)
+                return false;
+            memset(tiles + n, 0, emptyTiles);
+            n += emptyTiles;
+            c->p += 8;
+        }
+
+        SkipSpace(c);
+        if (c->p >= c->end)
+            return false;
+        if (*c->p == ']') {
+            c->p++;
+            break;
+        }
+        if (*c->p == ',') {
+            c->p++;
+            continue;
+        }
+
+        long gid;
+        if (!ReadInt(c, &gid) || n >= capacity)
+            return false;
+        // Strip Tiled's flip/rotation flags
+        gid &= 0x0FFFFFFFl;
+        if (gid > 0xFF)
+            return false;
+        tiles[n++] = (uint8_t)gid;
+    }
+    *count = n;
+    return true;
+}
+
+/**
+ * Count the entries of the array at the cursor, so that it can be parsed into an exactly sized buffer.
+ */
+static int CountArrayEntries(const JsonCursor* c) {
+    const char* end = memchr(c->p, ']', (size_t)(c->end - c->p));
+    if (end == nullptr)
+        return -1;
+    int commas = 0;
+    for (const char* p = c->p; p < end; p++)
+        commas += *p == ',';
+    return commas + 1;
+}
+
+static bool ParseLayer(JsonCursor* c, LevelData* out, bool* found) {
+    if (!Expect(c, '{'))
+        return false;
+    long width = 0, height = 0;
+    bool hasData = false;
+    SkipSpace(c);
+    if (c->p < c->end && *c->p == '}') {
+        c->p++;
+        return true;
+    }
+    do {
+        const char* key;
+        size_t keyLength;
+        if (!ReadString(c, &key, &keyLength) || !Expect(c, ':'))
+            return false;
+        SkipSpace(c);
+        if (StringIs(key, keyLength, "data") && !*found && c->p < c->end && *c->p == '[') {
+            int capacity = CountArrayEntries(c);
+            if (capacity <= 0)
+                return false;
+            out->tiles = malloc(capacity);
+            int count = 0;
+            if (out->tiles == nullptr || !ParseTileData(c, out->tiles, capacity, &count))
+                return false;
+            out->width = count;
+            hasData = true;
+        }
+        else if (StringIs(key, keyLength, "width")) {
+            if (!ReadInt(c, &width))
+                return false;
+        }
+        else if (StringIs(key, keyLength, "height")) {
+            if (!ReadInt(c, &height))
+                return false;
+        }
+        else if (!SkipValue(c)) {
+            return false;
+        }
+    } while (Expect(c, ','));
+    if (!Expect(c, '}'))
+        return false;
+
+    if (hasData) {
+        // out->width held the tile count until the layer's dimensions were known
+        if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF || width * height != out->width)
+            return false;
+        out->width = (int)width;
+        out->height = (int)height;
+        *found = true;
+    }
+    return true;
+}
+
+/**
+ * Parse a Tiled map (.tmj) into a level, using its first tile layer.
+ * Tiles map to tile codes through their id in the map's first tileset (Kenney.tsx):
+ * 1 = solid block, 2 = target, 3 = ball spawn.
+ * @param text The map's JSON
+ * @param length The length of the JSON
+ * @param out Receives the level. Free it with UnloadLevelData.
+ * @return False if the map is malformed, has no CSV tile layer or uses tiles without a tile code
+ */
+bool ParseTiledMap(const char* text, size_t length, LevelData* out) {
+    memset(out, 0, sizeof *out);
+    JsonCursor c = { text, text + length };
+    bool found = false;
+    long firstGid = 1;
+
+    if (!Expect(&c, '{'))
+        return false;
+    do {
+        const char* key;
+        size_t keyLength;
+        if (!ReadString(&c, &key, &keyLength) || !Expect(&c, ':'))
+            goto fail;
+        if (StringIs(key, keyLength, "layers")) {
+            if (!Expect(&c, '['))
+                goto fail;
+            SkipSpace(&c);
+            if (c.p < c.end && *c.p != ']') {
+                do {
+                    if (!ParseLayer(&c, out, &found))
+                        goto fail;
+                } while (Expect(&c, ','));
+            }
+            if (!Expect(&c, ']'))
+                goto fail;
+        }
+        else if (StringIs(key, keyLength, "tilesets")) {
+            // Only the first tileset's first id matters; the rest of the array is skipped
+            JsonCursor tilesets = c;
+            if (Expect(&tilesets, '[') && Expect(&tilesets, '{')) {
+                const char* tsKey;
+                size_t tsKeyLength;
+                while (ReadString(&tilesets, &tsKey, &tsKeyLength) && Expect(&tilesets, ':')) {
+                    if (StringIs(tsKey, tsKeyLength, "firstgid")) {
+                        ReadInt(&tilesets, &firstGid);
+                        break;
+                    }
+                    if (!SkipValue(&tilesets) || !Expect(&tilesets, ','))
+                        break;
+                }
+            }
+            if (!SkipValue(&c))
+                goto fail;
+        }
+        else if (!SkipValue(&c)) {
+            goto fail;
+        }
+    } while (Expect(&c, ','));
+
+    if (!found || firstGid < 1)
+        goto fail;
+
+    for (int i = 0; i < out->width * out->height; i++) {
+        int gid = out->tiles[i];
+        int code = gid == 0 ? TILE_EMPTY : gid - (int)firstGid + 1;
+        if (code < 0 || code >= TileCodeCount)
+            goto fail;
+        out->tiles[i] = (uint8_t)code;
+        out->targetCount += code == TILE_TARGET;
+        out->solidCount += code == TILE_SOLID;
+    }
+    FindLevelSpawn(out->tiles, out->width, out->height, &out->spawnCol, &out->spawnRow);
+    return true;
+
+fail:
+    UnloadLevelData(out);
+    memset(out, 0, sizeof *out);
+    return false;
+}
+
+/*  #########################
+ *      PARSED LEVEL CACHE
+ *  #########################
+ */
+
+constexpr int TILED_CACHE_SIZE = 16;
+
+typedef struct CachedLevel {
+    uint64_t hash;
+    size_t size;
+    uint64_t lastUse;
+    LevelData level;
+} CachedLevel;
+
+static CachedLevel cache[TILED_CACHE_SIZE] = { 0 };
+static uint64_t cacheClock = 0;
+
+// FNV-1a
+static uint64_t HashBytes(const uint8_t* bytes, size_t size) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static bool CopyLevelData(const LevelData* source, LevelData* destination) {
+    *destination = *source;
+    size_t count = (size_t)source->width * source->height;
+    destination->tiles = malloc(count);
+    if (destination->tiles == nullptr)
+        return false;
+    memcpy(destination->tiles, source->tiles, count);
+    return true;
+}
+
+/**
+ * Load a Tiled map as a level. Maps are cached by the hash of their contents,
+ * so loading an unchanged map again skips parsing, wherever it is loaded from.
+ * @param path The .tmj file
+ * @param out Receives the level. Free it with UnloadLevelData.
+ * @return False if the file could not be read or parsed
+ */
+bool LoadTiledLevel(const char* path, LevelData* out) {
+    memset(out, 0, sizeof *out);
+    size_t size;
+    const uint8_t* bytes = MapFile(path, &size);
+    if (bytes == nullptr)
+        return false;
+    uint64_t hash = HashBytes(bytes, size);
+    cacheClock++;
+
+    CachedLevel* slot = cache;
+    for (int i = 0; i < TILED_CACHE_SIZE; i++) {
+        if (cache[i].level.tiles != nullptr && cache[i].hash == hash && cache[i].size == size) {
+            UnmapFile(bytes, size);
+            cache[i].lastUse = cacheClock;
+            return CopyLevelData(&cache[i].level, out);
+        }
+        if (cache[i].lastUse < slot->lastUse)
+            slot = cache + i;
+    }
+
+    bool ok = ParseTiledMap((const char*)bytes, size, out);
+    UnmapFile(bytes, size);
+    if (!ok)
+        return false;
+
+    UnloadLevelData(&slot->level);
+    if (CopyLevelData(out, &slot->level)) {
+        slot->hash = hash;
+        slot->size = size;
+        slot->lastUse = cacheClock;
+    }
+    else {
+        memset(slot, 0, sizeof *slot);
+    }
+    return true;
+}
+
+void ClearTiledCache(void) {
+    for (int i = 0; i < TILED_CACHE_SIZE; i++) {
+        UnloadLevelData(&cache[i].level);
+        memset(cache + i, 0, sizeof cache[i]);
+    }
+}
@@ -0,0 +1,15 @@
+//
+// Created by frick on 2025-07-21.
+//
+
+#ifndef TILED_H
+#define TILED_H
+#include <stddef.h>
+
+#include "levelformat.h"
+
+bool ParseTiledMap(const char* text, size_t length, LevelData* out);
+bool LoadTiledLevel(const char* path, LevelData* out);
+void ClearTiledCache(void);
+
+#endif //TILED_H
@@ -0,0 +1,586 @@
+//
+// Created by frick on 2025-07-26.
+//
+// bench: microbenchmarks of the game's hot paths.
+// Usage: bench [--json out.json] [--filter text] [--samples n] [--workers n] [--draw]
+//        bench --compare baseline.json [current.json] [--threshold percent]
+//
+// Every benchmark is calibrated to take at least BENCH_SAMPLE_MS per sample, then sampled a number
+// of times after one warm-up sample. Results are reported per operation, in nanoseconds.
+// With --compare, the medians are compared against a baseline, either from a fresh run or from a
+// second file, and the exit code is 1 if anything got slower by more than the threshold and the noise.
+// Run it from the build directory, which has the assets and compiled levels next to it.
+//
+
+#include "../assets.h"
+#include "../atlas.h"
+#include "../balls.h"
+#include "../dispatch.h"
+#include "../entities.h"
+#include "../jobs.h"
+#include "../levels.h"
+#include "../logger.h"
+#include "../sprites.h"
+
+#include "box2d/box2d.h"
+#include "raylib.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Texture TextureLibrary[TextureEnumSize] = { 0 };
+TextureAtlas textureAtlas = { 0 };
+Sound SoundLibrary[SoundEnumSize] = { 0 };
+Font menuFont = { 0 };
+
+constexpr float BENCH_SAMPLE_MS = 5.0f;
+constexpr int BENCH_MAX_SAMPLES = 100;
+constexpr int BENCH_MAX_RESULTS = 64;
+constexpr int BENCH_MAX_LEVELS = 16;
+constexpr float LENGTH_UNITS_PER_METER = 128.0f;
+constexpr int SCREEN_WIDTH = 1920;
+constexpr int SCREEN_HEIGHT = 1080;
+
+/**
+ * Runs a benchmark's operation a number of times.
+ * @return Milliseconds spent in the part being measured
+ */
+typedef float BenchFcn(void* context, int iterations);
+
+typedef struct BenchResult {
+    char name[64];
+    int iterations;
+    int samples;
+    double min, median, mean, stddev, max;
+} BenchResult;
+
+static BenchResult results[BENCH_MAX_RESULTS];
+static int resultCount = 0;
+static int sampleCount = 15;
+static const char* filter = nullptr;
+
+static int CompareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void RunBenchmark(const char* name, BenchFcn* fcn, void* context) {
+    if (filter != nullptr && strstr(name, filter) == nullptr)
+        return;
+    if (resultCount == BENCH_MAX_RESULTS)
+        return;
+
+    // Double the iterations until a sample is long enough to time reliably
+    int iterations = 1;
+    while (fcn(context, iterations) < BENCH_SAMPLE_MS && iterations < (1 << 24))
+        iterations *= 2;
+
+    double perOp[BENCH_MAX_SAMPLES];
+    fcn(context, iterations);
+    for (int i = 0; i < sampleCount; i++)
+        perOp[i] = fcn(context, iterations) * 1e6 / iterations;
+    qsort(perOp, sampleCount, sizeof perOp[0], CompareDoubles);
+
+    BenchResult* result = results + resultCount++;
+    memset(result, 0, sizeof *result);
+    snprintf(result->name, sizeof result->name, "%s", name);
+    result->iterations = iterations;
+    result->samples = sampleCount;
+    result->min = perOp[0];
+    result->max = perOp[sampleCount - 1];
+    result->median = sampleCount % 2 ? perOp[sampleCount / 2] : 0.5 * (perOp[sampleCount / 2 - 1] + perOp[sampleCount / 2]);
+    for (int i = 0; i < sampleCount; i++)
+        result->mean += perOp[i];
+    result->mean /= sampleCount;
+    for (int i = 0; i < sampleCount; i++)
+        result->stddev += (perOp[i] - result->mean) * (perOp[i] - result->mean);
+    result->stddev = sqrt(result->stddev / sampleCount);
+
+    fprintf(stderr, "%-40s %12.1f ns/op  (+-%.1f, %d x %d)\n", name, result->median, result->stddev, sampleCount, iterations);
+}
+
+/*  #########################
+ *           SCENES
+ *  #########################
+*/
+
+typedef struct Scene {
+    b2WorldId worldId;
+    Level level;
+    BallPool* balls;
+    Paddle paddle;
+    // Let resting boxes sleep, as the game does
+    bool sleep;
+} Scene;
+
+static b2WorldId CreateBenchWorld(bool sleep) {
+    b2SetLengthUnitsPerMeter(LENGTH_UNITS_PER_METER);
+    b2WorldDef worldDef = b2DefaultWorldDef();
+    worldDef.gravity.y = 9.8f * LENGTH_UNITS_PER_METER;
+    worldDef.enableSleep = sleep;
+    worldDef.hitEventThreshold = 2.0f * LENGTH_UNITS_PER_METER;
+    JobsConfigureWorld(&worldDef);
+    return b2CreateWorld(&worldDef);
+}
+
+/**
+ * Roughly the game's scene: an enclosed arena, a level, a paddle, boxes and balls.
+ */
+static void CreateScene(Scene* scene, const LevelData* levelData, int boxCount, int ballCount) {
+    scene->worldId = CreateBenchWorld(scene->sleep);
+    b2WorldId worldId = scene->worldId;
+
+    float wall = 32.0f;
+    CreateSolid((b2Vec2){wall, SCREEN_HEIGHT / 2.0f}, (b2Vec2){wall, SCREEN_HEIGHT / 2.0f}, SPRITE_NONE, WHITE, worldId);
+    CreateSolid((b2Vec2){SCREEN_WIDTH - wall, SCREEN_HEIGHT / 2.0f}, (b2Vec2){wall, SCREEN_HEIGHT / 2.0f}, SPRITE_NONE, WHITE, worldId);
+    CreateSolid((b2Vec2){SCREEN_WIDTH / 2.0f, wall}, (b2Vec2){SCREEN_WIDTH / 2.0f, wall}, SPRITE_NONE, WHITE, worldId);
+    CreateSolid((b2Vec2){SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT - wall}, (b2Vec2){SCREEN_WIDTH / 2.0f, wall}, SPRITE_NONE, WHITE, worldId);
+
+    memset(&scene->level, 0, sizeof scene->level);
+    if (levelData != nullptr)
+        LoadLevel(&scene->level, levelData, (Vector2){2 * wall, 2 * wall}, worldId);
+
+    scene->paddle = CreatePaddle((b2Vec2){SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT * 0.95f}, 1.2f * LENGTH_UNITS_PER_METER, 0.4f * LENGTH_UNITS_PER_METER, BLUE, worldId);
+
+    b2Vec2 boxExtent = {0.5f * TextureLibrary[t_box].width, 0.5f * TextureLibrary[t_box].height};
+    int columns = (int)((SCREEN_WIDTH - 4 * wall) / (2.5f * boxExtent.x));
+    for (int i = 0; i < boxCount; i++) {
+        b2Vec2 position = {
+            2 * wall + boxExtent.x + (i % columns) * 2.5f * boxExtent.x,
+            SCREEN_HEIGHT * 0.8f - (i / columns) * 2.5f * boxExtent.y
+        };
+        CreatePhysicsBox(position, boxExtent, t_box, i, worldId);
+    }
+
+    InitBallPool(scene->balls, worldId);
+    float radius = 0.3f * LENGTH_UNITS_PER_METER;
+    for (int i = 0; i < ballCount; i++) {
+        b2Vec2 position = {SCREEN_WIDTH / 2.0f + (i % 16 - 8) * 2.5f * radius, SCREEN_HEIGHT * 0.5f - (i / 16) * 2.5f * radius};
+        b2Vec2 velocity = {(i % 2 ? 1.0f : -1.0f) * 4.0f * LENGTH_UNITS_PER_METER, -6.0f * LENGTH_UNITS_PER_METER};
+        SpawnBall(scene->balls, position, velocity, radius, t_ball, PURPLE);
+    }
+}
+
+static void DestroyScene(Scene* scene) {
+    b2DestroyWorld(scene->worldId);
+    UnloadLevel(&scene->level);
+}
+
+/*  #########################
+ *         BENCHMARKS
+ *  #########################
+*/
+
+typedef struct LevelBench {
+    const LevelData* levelData;
+} LevelBench;
+
+static float BenchLoadLevel(void* context, int iterations) {
+    const LevelBench* bench = context;
+    float elapsed = 0.0f;
+    for (int i = 0; i < iterations; i++) {
+        b2WorldId worldId = CreateBenchWorld(false);
+        Level level = { 0 };
+        uint64_t start = b2GetTicks();
+        LoadLevel(&level, bench->levelData, (Vector2){64, 64}, worldId);
+        UnloadLevel(&level);
+        elapsed += b2GetMilliseconds(start);
+        b2DestroyWorld(worldId);
+    }
+    return elapsed;
+}
+
+static float BenchResetLevel(void* context, int iterations) {
+    const LevelBench* bench = context;
+    b2WorldId worldId = CreateBenchWorld(false);
+    Level level = { 0 };
+    LoadLevel(&level, bench->levelData, (Vector2){64, 64}, worldId);
+    uint64_t start = b2GetTicks();
+    for (int i = 0; i < iterations; i++)
+        ResetLevel(&level, bench->levelData);
+    float elapsed = b2GetMilliseconds(start);
+    UnloadLevel(&level);
+    b2DestroyWorld(worldId);
+    return elapsed;
+}
+
+typedef struct StepBench {
+    const LevelData* levelData;
+    BallPool* balls;
+    int boxCount;
+    bool sleep;
+} StepBench;
+
+static float BenchWorldStep(void* context, int iterations) {
+    const StepBench* bench = context;
+    Scene scene = { .balls = bench->balls, .sleep = bench->sleep };
+    CreateScene(&scene, bench->levelData, bench->boxCount, 1);
+    // Let the boxes land, so the timed steps are spent in steady contact. Falling asleep takes the pile a few seconds more.
+    int settleSteps = bench->sleep ? 240 : 30;
+    for (int i = 0; i < settleSteps; i++)
+        b2World_Step(scene.worldId, 1.0f / 60.0f, 16);
+
+    uint64_t start = b2GetTicks();
+    for (int i = 0; i < iterations; i++)
+        b2World_Step(scene.worldId, 1.0f / 60.0f, 16);
+    float elapsed = b2GetMilliseconds(start);
+    DestroyScene(&scene);
+    return elapsed;
+}
+
+typedef struct HitBench {
+    Scene scene;
+    ContactDispatcher dispatcher;
+    b2ContactHitEvent* events;
+    int eventCount;
+    float checksum;
+} HitBench;
+
+// Does what the game's handler looks at, without changing the world
+static void OnBenchHit(ShapeRef ball, ShapeRef target, const void* event, void* context) {
+    HitBench* bench = context;
+    const b2ContactHitEvent* hit = event;
+    b2Vec2 velocity = b2Body_GetLinearVelocity(b2Shape_GetBody(ball.shapeId));
+    bench->checksum += velocity.x + hit->approachSpeed + (float)target.index;
+}
+
+static float BenchHitEvents(void* context, int iterations) {
+    HitBench* bench = context;
+    b2ContactEvents events = { 0 };
+    events.hitEvents = bench->events;
+    events.hitCount = bench->eventCount;
+    uint64_t start = b2GetTicks();
+    for (int i = 0; i < iterations; i++)
+        DispatchContactEvents(&bench->dispatcher, events, bench);
+    return b2GetMilliseconds(start);
+}
+
+typedef struct ToiBench {
+    Scene scene;
+    BallRayCastContext context;
+    int slot;
+    b2Vec2 start;
+    b2Vec2 velocity;
+} ToiBench;
+
+static float BenchBallPaddleToi(void* context, int iterations) {
+    ToiBench* bench = context;
+    b2BodyId ballId = bench->scene.balls->bodyIds[bench->slot];
+    float elapsed = 0.0f;
+    for (int i = 0; i < iterations; i++) {
+        // A hit moves the ball, so put it back first
+        b2Body_SetTransform(ballId, bench->start, b2Rot_identity);
+        b2Body_SetLinearVelocity(ballId, bench->velocity);
+        uint64_t start = b2GetTicks();
+        CheckBallPaddleCollision(bench->scene.balls, bench->slot, &bench->scene.paddle, &bench->context, 1.0f / 60.0f);
+        elapsed += b2GetMilliseconds(start);
+    }
+    return elapsed;
+}
+
+typedef struct DrawBench {
+    Scene scene;
+    bool balls;
+} DrawBench;
+
+static float BenchDraw(void* context, int iterations) {
+    DrawBench* bench = context;
+    Camera2D camera = { .offset = {SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f}, .target = {SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f}, .zoom = 0.5f };
+    BeginDrawing();
+    BeginMode2D(camera);
+    uint64_t start = b2GetTicks();
+    for (int i = 0; i < iterations; i++) {
+        if (bench->balls)
+            DrawBalls(bench->scene.balls);
+        else
+            DrawLevel(&bench->scene.level);
+        FlushSprites();
+    }
+    float elapsed = b2GetMilliseconds(start);
+    EndMode2D();
+    EndDrawing();
+    return elapsed;
+}
+
+/*  #########################
+ *        JSON AND COMPARE
+ *  #########################
+*/
+
+static bool WriteResults(const char* path) {
+    FILE* file = path != nullptr ? fopen(path, "w") : stdout;
+    if (file == nullptr)
+        return false;
+    // One benchmark per line, which is what ReadResults expects
+    fprintf(file, "{\n  \"unit\": \"ns/op\",\n  \"benchmarks\": [\n");
+    for (int i = 0; i < resultCount; i++) {
+        const BenchResult* r = results + i;
+        fprintf(file, "    {\"name\": \"%s\", \"iterations\": %d, \"samples\": %d, \"min\": %.3f, \"median\": %.3f, \"mean\": %.3f, \"stddev\": %.3f, \"max\": %.3f}%s\n",
+            r->name, r->iterations, r->samples, r->min, r->median, r->mean, r->stddev, r->max, i + 1 < resultCount ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return path == nullptr || fclose(file) == 0;
+}
+
+static bool ReadNumber(const char* line, const char* key, double* value) {
+    const char* at = strstr(line, key);
+    return at != nullptr && sscanf(at + strlen(key), " : %lf", value) == 1;
+}
+
+static int ReadResults(const char* path, BenchResult* out, int capacity) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr)
+        return -1;
+    int count = 0;
+    char line[512];
+    while (count < capacity && fgets(line, sizeof line, file) != nullptr) {
+        const char* name = strstr(line, "\"name\": \"");
+        if (name == nullptr)
+            continue;
+        BenchResult* r = out + count;
+        memset(r, 0, sizeof *r);
+        if (sscanf(name + 9, "%63[^\"]", r->name) != 1)
+            continue;
+        if (ReadNumber(line, "\"median\"", &r->median) && ReadNumber(line, "\"stddev\"", &r->stddev))
+            count++;
+    }
+    fclose(file);
+    return count;
+}
+
+/**
+ * @return Whether anything got slower by more than the threshold and its noise
+ */
+static bool Compare(const BenchResult* baseline, int baselineCount, const BenchResult* current, int currentCount, double threshold) {
+    bool regressed = false;
+    printf("%-40s %14s %14s %9s\n", "benchmark", "baseline ns", "current ns", "change");
+    for (int i = 0; i < currentCount; i++) {
+        const BenchResult* now = current + i;
+        const BenchResult* then = nullptr;
+        for (int j = 0; j < baselineCount && then == nullptr; j++) {
+            if (strcmp(baseline[j].name, now->name) == 0)
+                then = baseline + j;
+        }
+        if (then == nullptr || then->median <= 0.0) {
+            printf("%-40s %14s %14.1f %9s\n", now->name, "-", now->median, "new");
+            continue;
+        }
+        double change = (now->median - then->median) / then->median;
+        double noise = (now->stddev + then->stddev) / then->median;
+        const char* verdict = "";
+        if (fabs(change) > threshold && fabs(change) > noise) {
+            verdict = change > 0 ? "  slower" : "  faster";
+            regressed |= change > 0;
+        }
+        printf("%-40s %14.1f %14.1f %+8.1f%%%s\n", now->name, then->median, now->median, 100.0 * change, verdict);
+    }
+    return regressed;
+}
+
+/*  #########################
+ *            MAIN
+ *  #########################
+*/
+
+static void RunAll(bool draw) {
+    static BallPool balls;
+    static LevelData levelData[BENCH_MAX_LEVELS];
+    static char levelNames[BENCH_MAX_LEVELS][32];
+    int levelCount = 0;
+
+    // The built-in levels, compiled next to the executable, or straight from the maps otherwise
+    FilePathList paths = LoadDirectoryFilesEx("levels", ".rbl", false);
+    if (paths.count == 0) {
+        UnloadDirectoryFiles(paths);
+        paths = LoadDirectoryFilesEx("Tiled", ".tmj", false);
+    }
+    for (unsigned int i = 0; i < paths.count && levelCount < BENCH_MAX_LEVELS; i++) {
+        if (!LoadLevelFile(paths.paths[i], levelData + levelCount))
+            continue;
+        snprintf(levelNames[levelCount], sizeof levelNames[0], "%s", GetFileNameWithoutExt(paths.paths[i]));
+        levelCount++;
+    }
+    UnloadDirectoryFiles(paths);
+    if (levelCount == 0)
+        fprintf(stderr, "No levels found, run bench from the build directory\n");
+    const LevelData* sceneLevel = levelCount > 0 ? levelData : nullptr;
+
+    char name[64];
+    for (int i = 0; i < levelCount; i++) {
+        LevelBench bench = { levelData + i };
+        snprintf(name, sizeof name, "LoadLevel/%s", levelNames[i]);
+        RunBenchmark(name, BenchLoadLevel, &bench);
+        snprintf(name, sizeof name, "ResetLevel/%s", levelNames[i]);
+        RunBenchmark(name, BenchResetLevel, &bench);
+    }
+
+    const int boxCounts[] = {0, 10, 100, 500};
+    for (int i = 0; i < (int)(sizeof boxCounts / sizeof boxCounts[0]); i++) {
+        StepBench bench = { .levelData = sceneLevel, .balls = &balls, .boxCount = boxCounts[i], .sleep = false };
+        snprintf(name, sizeof name, "WorldStep/boxes:%d", boxCounts[i]);
+        RunBenchmark(name, BenchWorldStep, &bench);
+    }
+    // With sleep on, a settled pile should cost about as much as no boxes at all
+    const int restingCounts[] = {100, 500};
+    for (int i = 0; i < (int)(sizeof restingCounts / sizeof restingCounts[0]); i++) {
+        StepBench bench = { .levelData = sceneLevel, .balls = &balls, .boxCount = restingCounts[i], .sleep = true };
+        snprintf(name, sizeof name, "WorldStep/resting:%d", restingCounts[i]);
+        RunBenchmark(name, BenchWorldStep, &bench);
+    }
+
+    const int burstSizes[] = {16, 256, 4096};
+    for (int i = 0; i < (int)(sizeof burstSizes / sizeof burstSizes[0]); i++) {
+        static HitBench bench;
+        memset(&bench, 0, sizeof bench);
+        bench.scene.balls = &balls;
+        CreateScene(&bench.scene, sceneLevel, 0, 64);
+        RegisterContactHandler(&bench.dispatcher, CONTACT_HIT, SHAPE_BALL, SHAPE_TARGET, OnBenchHit);
+        bench.eventCount = burstSizes[i];
+        bench.events = calloc(bench.eventCount, sizeof bench.events[0]);
+        int targets = bench.scene.level.targetCount;
+        for (int e = 0; e < bench.eventCount; e++) {
+            b2ContactHitEvent* event = bench.events + e;
+            event->shapeIdA = balls.shapeIds[balls.active[e % balls.activeCount]];
+            // Without targets, the events route nowhere, which still measures the lookup
+            event->shapeIdB = targets > 0 ? bench.scene.level.targets[e % targets].shapeId : bench.scene.paddle.shapeId;
+            event->point = balls.positions[balls.active[e % balls.activeCount]];
+            event->normal = (b2Vec2){0, -1};
+            event->approachSpeed = 5.0f * LENGTH_UNITS_PER_METER;
+        }
+        snprintf(name, sizeof name, "HitEvents/burst:%d", burstSizes[i]);
+        RunBenchmark(name, BenchHitEvents, &bench);
+        free(bench.events);
+        DestroyScene(&bench.scene);
+    }
+
+    for (int hit = 0; hit <= 1; hit++) {
+        static ToiBench bench;
+        memset(&bench, 0, sizeof bench);
+        bench.scene.balls = &balls;
+        CreateScene(&bench.scene, nullptr, 0, 0);
+        b2Vec2 paddlePosition = b2Body_GetPosition(bench.scene.paddle.bodyId);
+        float radius = 0.3f * LENGTH_UNITS_PER_METER;
+        // Falling onto the paddle fast enough to cross it within the tick, or well above it
+        bench.start = (b2Vec2){paddlePosition.x, paddlePosition.y - (hit ? 2.0f : 6.0f) * LENGTH_UNITS_PER_METER};
+        bench.velocity = (b2Vec2){0, 150.0f * LENGTH_UNITS_PER_METER};
+        bench.slot = SpawnBall(&balls, bench.start, bench.velocity, radius, t_ball, PURPLE);
+        bench.context.shapeId = bench.scene.paddle.shapeId;
+        bench.context.targetShapeId = bench.scene.paddle.shapeId;
+        bench.context.point = (b2Vec2){paddlePosition.x, paddlePosition.y - bench.scene.paddle.extent.y};
+        bench.context.normal = (b2Vec2){0, -1};
+        RunBenchmark(hit ? "CheckBallPaddleCollision/hit" : "CheckBallPaddleCollision/miss", BenchBallPaddleToi, &bench);
+        DestroyScene(&bench.scene);
+    }
+
+    if (draw) {
+        for (int drawBalls = 0; drawBalls <= 1; drawBalls++) {
+            static DrawBench bench;
+            memset(&bench, 0, sizeof bench);
+            bench.scene.balls = &balls;
+            bench.balls = drawBalls;
+            CreateScene(&bench.scene, sceneLevel, 0, drawBalls ? 64 : 0);
+            if (drawBalls) {
+                // Give the trails some length
+                for (int i = 0; i < 60; i++) {
+                    b2World_Step(bench.scene.worldId, 1.0f / 60.0f, 16);
+                    RecordBallTrails(&balls);
+                }
+            }
+            RunBenchmark(drawBalls ? "Draw/DrawBalls:64" : "Draw/DrawLevel", BenchDraw, &bench);
+            DestroyScene(&bench.scene);
+        }
+    }
+
+    for (int i = 0; i < levelCount; i++)
+        UnloadLevelData(levelData + i);
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = nullptr;
+    const char* comparePaths[2] = { nullptr, nullptr };
+    double threshold = 0.05;
+    bool draw = false;
+    // One worker by default, so that results compare across machines
+    int workers = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            sampleCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]) / 100.0;
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+            workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--draw") == 0)
+            draw = true;
+        else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            comparePaths[0] = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                comparePaths[1] = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: bench [--json out.json] [--filter text] [--samples n] [--workers n] [--draw]\n");
+            fprintf(stderr, "       bench --compare baseline.json [current.json] [--threshold percent]\n");
+            return 2;
+        }
+    }
+    if (sampleCount < 1)
+        sampleCount = 1;
+    if (sampleCount > BENCH_MAX_SAMPLES)
+        sampleCount = BENCH_MAX_SAMPLES;
+
+    static BenchResult baseline[BENCH_MAX_RESULTS];
+    int baselineCount = 0;
+    if (comparePaths[0] != nullptr) {
+        baselineCount = ReadResults(comparePaths[0], baseline, BENCH_MAX_RESULTS);
+        if (baselineCount < 0) {
+            fprintf(stderr, "Could not read %s\n", comparePaths[0]);
+            return 2;
+        }
+    }
+    // Comparing two files needs no run at all
+    if (comparePaths[1] != nullptr) {
+        resultCount = ReadResults(comparePaths[1], results, BENCH_MAX_RESULTS);
+        if (resultCount < 0) {
+            fprintf(stderr, "Could not read %s\n", comparePaths[1]);
+            return 2;
+        }
+        return Compare(baseline, baselineCount, results, resultCount, threshold) ? 1 : 0;
+    }
+
+    LogInit();
+    LogSetFilters(SEVERITY_WARNING);
+    SetTraceLogLevel(LOG_WARNING);
+    JobsInit(workers);
+    if (draw) {
+        // Drawing needs a GL context, but nothing has to be shown
+        SetConfigFlags(FLAG_WINDOW_HIDDEN);
+        InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "bench");
+        LoadAssetLibraries();
+    }
+    else {
+        LoadAssetMetrics();
+    }
+
+    RunAll(draw);
+
+    if (draw) {
+        UnloadAssetLibraries();
+        CloseWindow();
+    }
+    JobsShutdown();
+    LogShutdown();
+
+    // When comparing, the table goes to stdout and the JSON only to a file
+    if ((jsonPath != nullptr || comparePaths[0] == nullptr) && !WriteResults(jsonPath)) {
+        fprintf(stderr, "Could not write %s\n", jsonPath);
+        return 2;
+    }
+    if (comparePaths[0] != nullptr)
+        return Compare(baseline, baselineCount, results, resultCount, threshold) ? 1 : 0;
+    return 0;
+}
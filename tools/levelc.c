@@ -0,0 +1,87 @@
+//
+// Created by frick on 2025-07-18.
+//
+// levelc: compiles Tiled maps (.tmj) into the game's binary level format (.rbl).
+// Usage: levelc <map.tmj> <level.rbl>
+//
+// The map is read with the same parser the game uses to load .tmj files directly (see tiled.c).
+//
+
+#include "../levelformat.h"
+#include "../tiled.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char* ReadFile(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr)
+        return nullptr;
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = malloc((size_t)length + 1);
+    if (text != nullptr && fread(text, 1, (size_t)length, file) == (size_t)length) {
+        text[length] = '\0';
+        *size = (size_t)length;
+    }
+    else {
+        free(text);
+        text = nullptr;
+    }
+    fclose(file);
+    return text;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <map.tmj> <level.rbl>\n", argv[0]);
+        return 1;
+    }
+
+    size_t size = 0;
+    char* text = ReadFile(argv[1], &size);
+    if (text == nullptr) {
+        fprintf(stderr, "levelc: cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    LevelData level;
+    bool parsed = ParseTiledMap(text, size, &level);
+    free(text);
+    if (!parsed) {
+        fprintf(stderr, "levelc: %s has no usable tile layer, or uses tiles without a tile code\n", argv[1]);
+        return 1;
+    }
+    long width = level.width, height = level.height;
+    long count = width * height;
+
+    size_t capacity = LEVEL_FILE_HEADER_SIZE + (size_t)count;
+    uint8_t* out = malloc(capacity);
+    if (out == nullptr) {
+        fprintf(stderr, "levelc: out of memory encoding %s\n", argv[1]);
+        UnloadLevelData(&level);
+        return 1;
+    }
+    size_t written = EncodeLevel(level.tiles, level.width, level.height, out, capacity);
+    UnloadLevelData(&level);
+    if (written == 0) {
+        fprintf(stderr, "levelc: cannot encode %s\n", argv[1]);
+        free(out);
+        return 1;
+    }
+
+    FILE* file = fopen(argv[2], "wb");
+    if (file == nullptr || fwrite(out, 1, written, file) != written) {
+        fprintf(stderr, "levelc: cannot write %s\n", argv[2]);
+        if (file != nullptr)
+            fclose(file);
+        free(out);
+        return 1;
+    }
+    fclose(file);
+    free(out);
+    printf("levelc: %s -> %s (%ldx%ld, %zu bytes)\n", argv[1], argv[2], width, height, written);
+    return 0;
+}
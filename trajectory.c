@@ -0,0 +1,238 @@
+//
+// Created by frick on 2025-07-23.
+//
+
+#include "trajectory.h"
+#include "box2d/box2d.h"
+#include "box2d/math_functions.h"
+#include "entities.h"
+
+/*
+ * Predicting the path means a short shape cast per tick of flight, which is too much to redo every
+ * tick, and pointless while the ball is doing what was predicted. So the path is kept, and every tick
+ * the ball is only compared with where the path says it should be. It is predicted again when the
+ * ball strays from it (a bounce off something moving, the paddle, a reset), when the level's geometry
+ * changes, or when the ball reaches its end.
+ */
+
+// How far, relative to its radius, the ball may drift from the path before it is predicted again
+static const float TRAJECTORY_POSITION_TOLERANCE = 0.25f;
+// How much, relative to the predicted speed, the ball's velocity may differ before it is predicted again
+static const float TRAJECTORY_VELOCITY_TOLERANCE = 0.05f;
+// Matches the ball's own restitution. Friction and spin are not modelled.
+static const float TRAJECTORY_RESTITUTION = 0.95f;
+// Most hits resolved within one tick, for when the ball is wedged in a corner
+constexpr int TRAJECTORY_HITS_PER_TICK = 4;
+
+void ResetTrajectory(Trajectory* trajectory) {
+    trajectory->valid = false;
+    trajectory->cursor = 0;
+    trajectory->pointCount = 0;
+    trajectory->bounceCount = 0;
+}
+
+typedef struct ClosestHit {
+    b2ShapeId shapeId;
+    b2Vec2 point;
+    b2Vec2 normal;
+    float fraction;
+    bool hit;
+} ClosestHit;
+
+static float ClosestHitFcn(b2ShapeId shapeId, b2Vec2 point, b2Vec2 normal, float fraction, void* context) {
+    ClosestHit* closest = context;
+    closest->shapeId = shapeId;
+    closest->point = point;
+    closest->normal = normal;
+    closest->fraction = fraction;
+    closest->hit = true;
+    // Clip the cast, so later hits are only reported if they are closer
+    return fraction;
+}
+
+static void Predict(Trajectory* trajectory, b2WorldId worldId, b2Vec2 position, b2Vec2 velocity) {
+    // Only static geometry is bounced off; the paddle is checked against the path separately
+    b2QueryFilter filter = {BALL, GROUND | TARGET};
+    b2Vec2 gravity = b2World_GetGravity(worldId);
+    float deltaTime = trajectory->deltaTime;
+
+    trajectory->cursor = 0;
+    trajectory->bounceCount = 0;
+    trajectory->points[0] = position;
+    trajectory->velocities[0] = velocity;
+    trajectory->pointCount = 1;
+
+    while (trajectory->pointCount < TRAJECTORY_MAX_POINTS && trajectory->bounceCount < TRAJECTORY_MAX_BOUNCES) {
+        // Constant acceleration over the tick, so the displacement uses the average velocity
+        b2Vec2 nextVelocity = b2MulAdd(velocity, deltaTime, gravity);
+        b2Vec2 translation = b2MulSV(0.5f * deltaTime, b2Add(velocity, nextVelocity));
+        velocity = nextVelocity;
+
+        float remaining = 1.0f;
+        for (int i = 0; i < TRAJECTORY_HITS_PER_TICK && remaining > 0.0f; i++) {
+            ClosestHit closest = { 0 };
+            b2ShapeProxy proxy = b2MakeProxy(&position, 1, trajectory->radius);
+            b2World_CastShape(worldId, &proxy, translation, filter, ClosestHitFcn, &closest);
+            // Touching something it is already leaving is not a hit
+            if (!closest.hit || b2Dot(velocity, closest.normal) >= 0.0f) {
+                position = b2Add(position, translation);
+                break;
+            }
+
+            position = b2MulAdd(position, closest.fraction, translation);
+            float normalSpeed = b2Dot(velocity, closest.normal);
+            velocity = b2MulSub(velocity, (1.0f + TRAJECTORY_RESTITUTION) * normalSpeed, closest.normal);
+            remaining *= 1.0f - closest.fraction;
+            float normalTravel = b2Dot(translation, closest.normal);
+            translation = b2MulSV(1.0f - closest.fraction, b2MulSub(translation, (1.0f + TRAJECTORY_RESTITUTION) * normalTravel, closest.normal));
+
+            TrajectoryHit* bounce = trajectory->bounces + trajectory->bounceCount++;
+            bounce->shapeId = closest.shapeId;
+            bounce->point = closest.point;
+            bounce->normal = closest.normal;
+            bounce->time = deltaTime * (trajectory->pointCount - remaining);
+            if (trajectory->bounceCount == TRAJECTORY_MAX_BOUNCES)
+                break;
+        }
+
+        trajectory->points[trajectory->pointCount] = position;
+        trajectory->velocities[trajectory->pointCount] = velocity;
+        trajectory->pointCount++;
+    }
+    trajectory->valid = true;
+}
+
+/**
+ * Keep a body's predicted path up to date. Call once per simulation tick.
+ * @param bodyId The ball to follow
+ * @param radius The ball's radius
+ * @param deltaTime The simulation tick
+ * @param geometryVersion Anything that changes it whenever the level's shapes change
+ * @return Whether the path was predicted again
+ */
+bool UpdateTrajectory(Trajectory* trajectory, b2WorldId worldId, b2BodyId bodyId, float radius, float deltaTime, uint32_t geometryVersion) {
+    b2Vec2 position = b2Body_GetPosition(bodyId);
+    b2Vec2 velocity = b2Body_GetLinearVelocity(bodyId);
+
+    bool stale = !trajectory->valid
+        || !B2_ID_EQUALS(trajectory->bodyId, bodyId)
+        || trajectory->radius != radius
+        || trajectory->deltaTime != deltaTime
+        || trajectory->geometryVersion != geometryVersion;
+
+    if (!stale) {
+        // The ball moves on by a point per tick, or stays put while the game is paused
+        int cursor = trajectory->cursor;
+        while (cursor + 1 < trajectory->pointCount
+            && b2DistanceSquared(trajectory->points[cursor + 1], position) < b2DistanceSquared(trajectory->points[cursor], position))
+            cursor++;
+        trajectory->cursor = cursor;
+
+        b2Vec2 expected = trajectory->velocities[cursor];
+        stale = cursor + 1 >= trajectory->pointCount
+            || b2Distance(trajectory->points[cursor], position) > TRAJECTORY_POSITION_TOLERANCE * radius
+            || b2Distance(expected, velocity) > TRAJECTORY_VELOCITY_TOLERANCE * b2Length(expected) + 1.0f;
+    }
+    if (!stale)
+        return false;
+
+    trajectory->bodyId = bodyId;
+    trajectory->radius = radius;
+    trajectory->deltaTime = deltaTime;
+    trajectory->geometryVersion = geometryVersion;
+    Predict(trajectory, worldId, position, velocity);
+    return true;
+}
+
+/**
+ * @param count Receives how many points are left
+ * @return The rest of the path, starting at the ball, one point per tick
+ */
+const b2Vec2* GetTrajectoryPath(const Trajectory* trajectory, int* count) {
+    if (!trajectory->valid) {
+        *count = 0;
+        return nullptr;
+    }
+    *count = trajectory->pointCount - trajectory->cursor;
+    return trajectory->points + trajectory->cursor;
+}
+
+/**
+ * Find where the rest of the path first meets a shape that it did not bounce off, e.g. the paddle.
+ * Only the parts of the path near the shape's bounds are cast against it.
+ * @param proxy The shape, in its local space
+ * @param transform Where the shape is
+ * @param bounds The shape's AABB
+ * @param hit Receives the contact, with the normal pointing away from the shape
+ * @return Whether the path meets the shape
+ */
+bool FindTrajectoryContact(const Trajectory* trajectory, b2ShapeProxy proxy, b2Transform transform, b2AABB bounds, TrajectoryHit* hit) {
+    if (!trajectory->valid)
+        return false;
+    float r = trajectory->radius;
+    b2ShapeProxy ball = b2MakeProxy(&b2Vec2_zero, 1, r);
+
+    for (int i = trajectory->cursor; i + 1 < trajectory->pointCount; i++) {
+        b2Vec2 a = trajectory->points[i];
+        b2Vec2 b = trajectory->points[i + 1];
+        if (b2MinFloat(a.x, b.x) - r > bounds.upperBound.x || b2MaxFloat(a.x, b.x) + r < bounds.lowerBound.x
+            || b2MinFloat(a.y, b.y) - r > bounds.upperBound.y || b2MaxFloat(a.y, b.y) + r < bounds.lowerBound.y)
+            continue;
+
+        b2ShapeCastPairInput input = { 0 };
+        input.proxyA = proxy;
+        input.proxyB = ball;
+        input.transformA = transform;
+        input.transformB = (b2Transform){a, b2Rot_identity};
+        input.translationB = b2Sub(b, a);
+        input.maxFraction = 1.0f;
+        b2CastOutput output = b2ShapeCast(&input);
+        if (!output.hit)
+            continue;
+
+        hit->shapeId = b2_nullShapeId;
+        hit->point = output.point;
+        hit->normal = output.normal;
+        hit->time = trajectory->deltaTime * (i + output.fraction);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Find where the rest of the path next comes down through a horizontal line, e.g. to have a player
+ * move to where the ball will land.
+ * @param y The line's height
+ * @param point Receives where the path crosses it
+ * @return Whether the path crosses it
+ */
+bool FindTrajectoryCrossing(const Trajectory* trajectory, float y, b2Vec2* point) {
+    if (!trajectory->valid)
+        return false;
+    for (int i = trajectory->cursor; i + 1 < trajectory->pointCount; i++) {
+        b2Vec2 a = trajectory->points[i];
+        b2Vec2 b = trajectory->points[i + 1];
+        if (a.y < y && b.y >= y) {
+            float t = (y - a.y) / (b.y - a.y);
+            *point = b2Lerp(a, b, t);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Draw the rest of the path as an aim guide, with a mark at each bounce.
+ */
+void DrawTrajectory(const Trajectory* trajectory, Color color) {
+    int count;
+    const b2Vec2* path = GetTrajectoryPath(trajectory, &count);
+    for (int i = 0; i + 1 < count; i++)
+        DrawLineV((Vector2){path[i].x, path[i].y}, (Vector2){path[i + 1].x, path[i + 1].y}, color);
+    for (int i = 0; i < trajectory->bounceCount; i++) {
+        // Bounces the ball already made
+        if (trajectory->bounces[i].time < trajectory->cursor * trajectory->deltaTime)
+            continue;
+        DrawCircleLines(trajectory->bounces[i].point.x, trajectory->bounces[i].point.y, 0.25f * trajectory->radius, color);
+    }
+}
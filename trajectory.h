@@ -0,0 +1,52 @@
+//
+// Created by frick on 2025-07-23.
+//
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "box2d/types.h"
+#include "box2d/collision.h"
+#include "raylib.h"
+#include <stdint.h>
+
+constexpr int TRAJECTORY_MAX_POINTS = 256;
+constexpr int TRAJECTORY_MAX_BOUNCES = 4;
+
+typedef struct TrajectoryHit {
+    b2ShapeId shapeId;
+    b2Vec2 point;
+    b2Vec2 normal;
+    // Seconds from when the path was predicted
+    float time;
+} TrajectoryHit;
+
+/**
+ * A ball's predicted path under gravity, bouncing off static geometry, one point per simulation tick.
+ * It is kept for as long as the ball follows it, see UpdateTrajectory.
+ */
+typedef struct Trajectory {
+    // What the path was predicted from
+    b2BodyId bodyId;
+    float radius;
+    float deltaTime;
+    uint32_t geometryVersion;
+    bool valid;
+
+    // Where the ball is along the path
+    int cursor;
+    int pointCount;
+    b2Vec2 points[TRAJECTORY_MAX_POINTS];
+    b2Vec2 velocities[TRAJECTORY_MAX_POINTS];
+    int bounceCount;
+    TrajectoryHit bounces[TRAJECTORY_MAX_BOUNCES];
+} Trajectory;
+
+void ResetTrajectory(Trajectory* trajectory);
+bool UpdateTrajectory(Trajectory* trajectory, b2WorldId worldId, b2BodyId bodyId, float radius, float deltaTime, uint32_t geometryVersion);
+const b2Vec2* GetTrajectoryPath(const Trajectory* trajectory, int* count);
+bool FindTrajectoryContact(const Trajectory* trajectory, b2ShapeProxy proxy, b2Transform transform, b2AABB bounds, TrajectoryHit* hit);
+bool FindTrajectoryCrossing(const Trajectory* trajectory, float y, b2Vec2* point);
+void DrawTrajectory(const Trajectory* trajectory, Color color);
+
+#endif //TRAJECTORY_H